@@ -14,18 +14,23 @@
  * limitations under the License.
  */
 
+#include <ctype.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <pthread.h>
 #include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <string>
 #include <vector>
 
 #include "Lights.h"
+#include "LightsTrace.h"
 
 #include <android-base/logging.h>
+#include <android-base/properties.h>
 
 namespace aidl {
 namespace android {
@@ -34,114 +39,694 @@ namespace light {
 
 static int64_t const ONE_MS_IN_NS = 1000000LL;
 
+static int const MAX_RAMP_MS = 10000;
+static int const RAMP_RATE_HZ_DEFAULT = 60;
+
+static void* execApply(void *arg) {
+    Lights* _this = static_cast<Lights*>(arg);
+    _this->applyRoutine();
+    return nullptr;
+}
+
 Lights::Lights() {
-    // Add one light by type in list
-    addLight(LightType::BACKLIGHT, 0);
-    addLight(LightType::KEYBOARD, 0);
-    addLight(LightType::BUTTONS, 0);
-    addLight(LightType::BATTERY, 0);
-    addLight(LightType::NOTIFICATIONS, 0);
-    addLight(LightType::ATTENTION, 0);
-    addLight(LightType::BLUETOOTH, 0);
-    addLight(LightType::WIFI, 0);
-    addLight(LightType::MICROPHONE, 0);
+    std::vector<LightsMapping> mappings;
+    int64_t start = LightsScheduler::getTimestampMonotonic();
+
+    // Add one light by physical device found. Lights without device are not exposed,
+    // except those of the mapping file when hotplug is enabled: they wait for their device
+    LightsUtils::discoverLights(&mappings, &missingLights);
+    for (auto i = mappings.begin(); i != mappings.end(); i++) {
+        if (addLight(i->type, i->ordinal, i->led) != 0) {
+            LOG(ERROR) << "Light table full (" << LIGHTS_MAX_LIGHTS << "), "
+                       << LightsUtils::getLightTypeName(i->type) << " ordinal " << i->ordinal
+                       << " not exposed";
+            continue;
+        }
+        LOG(INFO) << "Light " << LightsUtils::getLightTypeName(i->type) << " ordinal "
+                  << i->ordinal << " on " << i->led->getName();
+    }
+    for (auto i = missingLights.begin(); i != missingLights.end(); i++) {
+        LOG(INFO) << "Light " << LightsUtils::getLightTypeName(*i) << " has no device";
+    }
+
+    discoveryTime = LightsScheduler::getTimestampMonotonic() - start;
+    LOG(INFO) << "Lights discovered " << nbLights << " lights in "
+              << discoveryTime / 1000 << "us";
+
+    // Probe the devices: nodes opened, max brightness, channels and triggers read once
+    start = LightsScheduler::getTimestampMonotonic();
+    for (HwLightConfig* i = availableLights; i != availableLights + nbLights; i++) {
+        /* no-op for a device shared with a previous light */
+        i->led->probe();
+    }
+    probeTime = LightsScheduler::getTimestampMonotonic() - start;
+
+    asyncApply = ::android::base::GetBoolProperty("ro.vendor.lights.async", false);
+    if (asyncApply) {
+        pthread_t thread;
+        if (pthread_create(&thread, nullptr, execApply, this) != 0) {
+            LOG(ERROR) << "Cannot create the apply thread, lights updated synchronously";
+            asyncApply = false;
+        } else {
+            pthread_setname_np(thread, "lights-apply");
+            pthread_detach(thread);
+        }
+    }
+}
+
+/**
+ * Start the resources not needed to answer the first calls, once the
+ * service is registered. Those are otherwise started on first use.
+ */
+void Lights::warmUp() {
+    int64_t start = LightsScheduler::getTimestampMonotonic();
+
+    if (LightsScheduler::getInstance()->start() != 0) {
+        LOG(ERROR) << "Lights scheduler not running, TIMED flash unavailable";
+    }
+    if (LightsUtils::isHotplugEnabled() && (startHotplug(-1) != 0)) {
+        LOG(ERROR) << "Lights hotplug unavailable, devices removed are not tracked";
+    }
+    warmUpTime = LightsScheduler::getTimestampMonotonic() - start;
+}
+
+/**
+ * Track the devices coming and going
+ * @param fd = datagram socket carrying uevents, -1 for the kernel uevents
+ * @return 0 if success, error code otherwise
+ */
+int Lights::startHotplug(int fd) {
+    if (hotplug == nullptr) {
+        hotplug = new LightsHotplug(this);
+    }
+    return hotplug->start(fd);
+}
+
+/**
+ * Apply the output of a device back, with the latest state of its owner
+ * @param led = device attached again
+ */
+void Lights::onLedAdded(LightsLed* led) {
+    for (int id = 0; id < nbLights; id++) {
+        HwLightConfig& config = availableLights[id];
+        if ((config.led != led) || (config.compositor->getOwner() != id)) {
+            continue;
+        }
+        config.led->lockWrite();
+        /* owner may have changed before the lock */
+        if (config.compositor->getOwner() == id) {
+            int ret = applyOutput(&config, config.state);
+            config.output = config.state;
+            config.outputValid = (ret == EX_NONE);
+        }
+        config.led->unlockWrite();
+    }
+}
+
+/**
+ * Stop driving a device gone, requests are kept until it comes back
+ * @param led = device detached
+ */
+void Lights::onLedRemoved(LightsLed* led) {
+    for (int id = 0; id < nbLights; id++) {
+        HwLightConfig& config = availableLights[id];
+        if (config.led != led) {
+            continue;
+        }
+        config.led->lockWrite();
+        stopOutput(&config);
+        if (config.lightsRamp != nullptr) {
+            config.lightsRamp->stop();
+        }
+        config.led->unlockWrite();
+    }
 }
 
 ScopedAStatus Lights::setLightState(int id, const HwLightState& state) {
 
-    LOG(INFO) << "Lights setting state for id=" << id
-              << " to color " << std::hex << state.color
-              << " with flash mode " << LightsUtils::getFlashModeName(state.flashMode);
+    LOG(VERBOSE) << "Lights setting state for id=" << id
+                 << " to color " << std::hex << state.color
+                 << " with flash mode " << LightsUtils::getFlashModeName(state.flashMode);
 
-    if (!(0 <= id && id < availableLights.size())) {
+    int64_t start = LightsScheduler::getTimestampMonotonic();
+
+    LightsTrace::record(LightsTraceEvent::SET_LIGHT_STATE, id, state.color);
+
+    int ret = checkLightState(id, state);
+    if ((ret != EX_NONE) && !(0 <= id && id < nbLights)) {
+        rejectedCalls.fetch_add(1, std::memory_order_relaxed);
+        LightsTrace::record(LightsTraceEvent::SET_LIGHT_STATE_DONE, id, ret);
+        return ScopedAStatus::fromExceptionCode(ret);
+    }
+
+    HwLightConfig* config = &availableLights[id];
+
+    if (ret == EX_NONE) {
+        if (asyncApply) {
+            storePendingState(config, state);
+            notifyApply();
+        } else {
+            ret = applyLightState(config, state);
+        }
+    }
+
+    config->stats.record(ret != EX_NONE, LightsScheduler::getTimestampMonotonic() - start);
+    LightsTrace::record(LightsTraceEvent::SET_LIGHT_STATE_DONE, id, ret);
+
+    if (ret != EX_NONE) {
+        return ScopedAStatus::fromExceptionCode(ret);
+    }
+    return ScopedAStatus::ok();
+}
+
+/**
+ * Check a light state request
+ * @param id = light id
+ * @param state = requested state
+ * @return EX_NONE if valid, exception code otherwise
+ */
+int Lights::checkLightState(int id, const HwLightState& state)
+{
+    if (!(0 <= id && id < nbLights)) {
         LOG(ERROR) << "Light id " << (int32_t)id << " does not exist.";
-        return ScopedAStatus::fromExceptionCode(EX_UNSUPPORTED_OPERATION);
+        return EX_UNSUPPORTED_OPERATION;
     }
 
     if (state.brightnessMode == BrightnessMode::LOW_PERSISTENCE) {
         LOG(ERROR) << "Light brightness mode LOW PERSISTENCE not managed";
-        return ScopedAStatus::fromExceptionCode(EX_UNSUPPORTED_OPERATION);
+        return EX_UNSUPPORTED_OPERATION;
     }
 
-    HwLightConfig* config = &availableLights[id];
+    if ((state.flashMode == FlashMode::TIMED) &&
+        (availableLights[id].hwLight.type != LightType::BACKLIGHT) &&
+        (checkFlashParams(state) != 0)) {
+        LOG(ERROR) << "Flash state is invalid";
+        return EX_UNSUPPORTED_OPERATION;
+    }
+
+    return EX_NONE;
+}
+
+/**
+ * Apply a light state: the device is driven only if the light owns its
+ * output, otherwise the request is kept until it does
+ * @param config = light
+ * @param state = requested state, already checked
+ * @return EX_NONE if success, exception code otherwise
+ */
+int Lights::applyLightState(HwLightConfig* config, const HwLightState& state)
+{
+    int ret;
+
+    config->led->lockWrite();
+    ret = applyLightStateLocked(config, state);
+    config->led->unlockWrite();
+
+    return ret;
+}
+
+/**
+ * Update the state of a light, called with the device write mutex held
+ * @param config = light
+ * @param state = state to apply, already checked
+ * @return EX_NONE if success, exception code otherwise
+ */
+int Lights::applyLightStateLocked(HwLightConfig* config, const HwLightState& state)
+{
+    int ret = EX_NONE;
+    int id = config->hwLight.id;
+
+    config->state = state;
+
+    int previous = config->compositor->getOwner();
+    int owner = config->compositor->setLit(id, (state.color & 0x00FFFFFF) != 0);
+
+    if (owner == id) {
+        if ((previous != id) && (previous >= 0)) {
+            stopOutput(&availableLights[previous]);
+        }
+        if (config->outputValid && isSameState(config->output, state)) {
+            /* composited output unchanged */
+            unchangedOutputs.fetch_add(1, std::memory_order_relaxed);
+        } else {
+            ret = applyOutput(config, state);
+            config->output = state;
+            config->outputValid = (ret == EX_NONE);
+        }
+    } else if (previous == id) {
+        /* masked now: hand the output over */
+        stopOutput(config);
+        HwLightConfig* output = &availableLights[owner];
+        ret = applyOutput(output, output->state);
+        output->output = output->state;
+        output->outputValid = (ret == EX_NONE);
+    } else {
+        /* masked: kept for when the light gets the output back */
+        maskedRequests.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    return ret;
+}
+
+/**
+ * Update several lights at once. All updates are checked before any is
+ * applied, then the lights of each device are updated under a single
+ * acquisition of its write mutex. When a light is listed several times,
+ * its last update wins.
+ * @param updates = light updates
+ * @param nbUpdates = number of updates, at most MAX_BATCH
+ * @return EX_NONE if success, exception code otherwise (first failure)
+ */
+int Lights::setLightStates(const LightsUpdate* updates, int nbUpdates)
+{
+    bool done[MAX_BATCH] = {};
+    int ret = EX_NONE;
+    int64_t start = LightsScheduler::getTimestampMonotonic();
+
+    LightsTrace::record(LightsTraceEvent::SET_LIGHT_STATES, nbUpdates, 0);
+
+    if ((nbUpdates < 0) || (nbUpdates > MAX_BATCH)) {
+        LOG(ERROR) << "Invalid batch of " << nbUpdates << " light updates";
+        ret = EX_ILLEGAL_ARGUMENT;
+    }
+    for (int i = 0; (ret == EX_NONE) && (i < nbUpdates); i++) {
+        ret = checkLightState(updates[i].id, updates[i].state);
+    }
+
+    if ((ret == EX_NONE) && asyncApply) {
+        for (int i = 0; i < nbUpdates; i++) {
+            storePendingState(&availableLights[updates[i].id], updates[i].state);
+        }
+        notifyApply();
+    } else if (ret == EX_NONE) {
+        for (int i = 0; i < nbUpdates; i++) {
+            if (done[i]) {
+                continue;
+            }
+            LightsLed* led = availableLights[updates[i].id].led;
+
+            /* every light of the batch sharing this device */
+            led->lockWrite();
+            for (int j = i; j < nbUpdates; j++) {
+                HwLightConfig* config = &availableLights[updates[j].id];
+                if (done[j] || (config->led != led)) {
+                    continue;
+                }
+                done[j] = true;
+
+                bool superseded = false;
+                for (int k = j + 1; k < nbUpdates; k++) {
+                    superseded |= (updates[k].id == updates[j].id);
+                }
+                if (superseded) {
+                    continue;
+                }
+
+                int err = applyLightStateLocked(config, updates[j].state);
+                if (ret == EX_NONE) {
+                    ret = err;
+                }
+            }
+            led->unlockWrite();
+        }
+    }
+
+    batchStats.record(ret != EX_NONE, LightsScheduler::getTimestampMonotonic() - start);
+    LightsTrace::record(LightsTraceEvent::SET_LIGHT_STATES_DONE, nbUpdates, ret);
+
+    return ret;
+}
+
+/**
+ * Stop the flash and pattern of a light losing the device output, called
+ * with the device write mutex held
+ * @param config = light
+ */
+void Lights::stopOutput(HwLightConfig* config)
+{
+    if (config->flashMode == FlashMode::TIMED) {
+        config->lightsFlash->stop();
+    }
+    if (config->lightsPattern != nullptr) {
+        config->lightsPattern->stop();
+    }
+    config->flashMode = FlashMode::NONE;
+    config->backend = LightsBackend::NONE;
+    config->outputValid = false;
+}
+
+/**
+ * Tell if two states give the same output
+ * @param a = state
+ * @param b = state
+ * @return true if identical
+ */
+bool Lights::isSameState(const HwLightState& a, const HwLightState& b)
+{
+    return (a.color == b.color) && (a.flashMode == b.flashMode) &&
+           (a.flashOnMs == b.flashOnMs) && (a.flashOffMs == b.flashOffMs) &&
+           (a.brightnessMode == b.brightnessMode);
+}
 
-    pthread_mutex_lock(&config->writeMutex);
+/**
+ * Drive the device with the state of the light owning its output, called
+ * with the device write mutex held
+ * @param config = light owning the output
+ * @param state = state to apply, already checked
+ * @return EX_NONE if success, exception code otherwise
+ */
+int Lights::applyOutput(HwLightConfig* config, const HwLightState& state)
+{
+    if (!config->led->isPresent()) {
+        /* unplugged: applied when the device comes back */
+        deferredRequests.fetch_add(1, std::memory_order_relaxed);
+        return EX_NONE;
+    }
 
     // Manage backlight specific case
     if (config->hwLight.type == LightType::BACKLIGHT) {
-        if (LightsUtils::isBacklightAvailable()) {
-            int ret = LightsUtils::setBacklightValue(state.color);
-            pthread_mutex_unlock(&config->writeMutex);
-            if (ret < 0) {
-                return ScopedAStatus::fromExceptionCode(EX_TRANSACTION_FAILED);
-            } else {
-                return ScopedAStatus::ok();
-            }
+        int ret;
+        if (config->lightsRamp != nullptr) {
+            config->backend = LightsBackend::RAMP;
+            ret = LightsUtils::setRampValue(config->lightsRamp, config->led, state.color,
+                                            config->rampMs);
+        } else {
+            config->backend = LightsBackend::STEADY;
+            ret = LightsUtils::setBacklightValue(config->led, state.color);
+        }
+        if (ret < 0) {
+            return EX_TRANSACTION_FAILED;
+        } else {
+            return EX_NONE;
         }
-        // case no backlight available: stub
-        return ScopedAStatus::ok();
     }
 
-    const char* name = LightsUtils::getLedName(config->hwLight.type);
-    if (name == nullptr) {
-        // no led associated to required type, stub
-        pthread_mutex_unlock(&config->writeMutex);
-        return ScopedAStatus::ok();
+    if ((config->flashMode == FlashMode::TIMED) && (state.flashMode == FlashMode::TIMED) &&
+        (config->backend == LightsBackend::USERSPACE) &&
+        (config->lightsFlash->retime(state) == 0)) {
+        /* new color and delays from the next edge, no restart */
+        return EX_NONE;
     }
 
     if (config->flashMode == FlashMode::TIMED) {
-        /* destroy flashing thread */
+        /* stop flashing */
         config->flashMode = FlashMode::NONE;
         if (config->lightsFlash != nullptr) {
             config->lightsFlash->stop();
         }
     }
+    if (config->lightsPattern != nullptr) {
+        config->lightsPattern->stop();
+    }
 
     int ret = 0;
+    bool ramp = (config->lightsRamp != nullptr) &&
+                (state.flashMode != FlashMode::HARDWARE) && (state.flashMode != FlashMode::TIMED);
 
-    if (state.flashMode != FlashMode::TIMED) {
-        ret = LightsUtils::setColorValue(name, state.color, state.flashMode == FlashMode::HARDWARE);
+    if ((config->lightsRamp != nullptr) && !ramp) {
+        /* the device is about to be driven by a trigger or a flash */
+        config->lightsRamp->stop();
+    }
+
+    if (ramp) {
+        config->backend = LightsBackend::RAMP;
+        ret = LightsUtils::setRampValue(config->lightsRamp, config->led, state.color,
+                                        config->rampMs);
         if (ret < 0) {
-            pthread_mutex_unlock(&config->writeMutex);
-            return ScopedAStatus::fromExceptionCode(EX_TRANSACTION_FAILED);
+            return EX_TRANSACTION_FAILED;
+        }
+    } else if (state.flashMode == FlashMode::HARDWARE) {
+        /* vendor pattern if any, else the requested delays if the led has a blink trigger */
+        config->backend = LightsBackend::NONE;
+        if ((config->lightsPattern != nullptr) && config->lightsPattern->hasPreset()) {
+            config->backend = config->lightsPattern->startPreset(state.color);
+        }
+        if ((config->backend == LightsBackend::NONE) && (checkFlashParams(state) == 0)) {
+            config->backend = LightsUtils::setKernelFlashValue(config->led, state.color,
+                                                               state.flashOnMs, state.flashOffMs);
+        }
+        if (config->backend == LightsBackend::NONE) {
+            config->backend = LightsBackend::HEARTBEAT;
+            ret = LightsUtils::setColorValue(config->led, state.color, true);
+        }
+        if (ret < 0) {
+            return EX_TRANSACTION_FAILED;
+        }
+    } else if (state.flashMode != FlashMode::TIMED) {
+        config->backend = LightsBackend::STEADY;
+        ret = LightsUtils::setColorValue(config->led, state.color, false);
+        if (ret < 0) {
+            return EX_TRANSACTION_FAILED;
         }
     } else {
-        /* start flashing thread */
-        if (checkFlashParams(state) == 0) {
-            if (config->lightsFlash == nullptr) {
-                config->lightsFlash = new LightsFlash(config->hwLight);
-            }
-            config->lightsFlash->setLightState(state);
-            ret = config->lightsFlash->start();
-            if (ret != 0) {
-                LOG(ERROR) << "Cannot create flashing thread";
-                config->flashMode = FlashMode::NONE;
-                pthread_mutex_unlock(&config->writeMutex);
-                return ScopedAStatus::fromExceptionCode(EX_TRANSACTION_FAILED);
-            }
+        /* start flashing, in kernel if possible */
+        config->backend = LightsUtils::setKernelFlashValue(config->led, state.color,
+                                                           state.flashOnMs, state.flashOffMs);
+        if (config->backend != LightsBackend::NONE) {
             config->flashMode = FlashMode::TIMED;
-        } else {
-            LOG(ERROR) << "Flash state is invalid";
+            return EX_NONE;
+        }
+        config->backend = LightsBackend::USERSPACE;
+        config->lightsFlash->setLightState(state);
+        ret = config->lightsFlash->start();
+        if (ret != 0) {
+            LOG(ERROR) << "Cannot start flashing";
             config->flashMode = FlashMode::NONE;
-            pthread_mutex_unlock(&config->writeMutex);
-            return ScopedAStatus::fromExceptionCode(EX_UNSUPPORTED_OPERATION);
+            config->backend = LightsBackend::NONE;
+            return EX_TRANSACTION_FAILED;
         }
+        config->flashMode = FlashMode::TIMED;
     }
 
-    pthread_mutex_unlock(&config->writeMutex);
-    return ScopedAStatus::ok();
+    return EX_NONE;
+}
+
+/**
+ * Store a light state for the apply thread. A state not applied yet is
+ * replaced (latest wins).
+ * @param config = light
+ * @param state = requested state, already checked
+ */
+void Lights::storePendingState(HwLightConfig* config, const HwLightState& state)
+{
+    pthread_mutex_lock(&config->pendingMutex);
+    if (config->pending) {
+        coalescedUpdates.fetch_add(1, std::memory_order_relaxed);
+    }
+    config->pendingState = state;
+    config->pending = true;
+    pthread_mutex_unlock(&config->pendingMutex);
+}
+
+/**
+ * Wake up the apply thread for the states stored so far
+ */
+void Lights::notifyApply()
+{
+    pthread_mutex_lock(&applyMutex);
+    publishedSeq++;
+    pthread_cond_signal(&applyCond);
+    pthread_mutex_unlock(&applyMutex);
+}
+
+/**
+ * Apply thread: apply the latest published state of each light
+ */
+void Lights::applyRoutine()
+{
+    HwLightState state;
+
+    for (;;) {
+        pthread_mutex_lock(&applyMutex);
+        while (appliedSeq == publishedSeq) {
+            pthread_cond_wait(&applyCond, &applyMutex);
+        }
+        uint64_t seq = publishedSeq;
+        pthread_mutex_unlock(&applyMutex);
+
+        for (HwLightConfig* i = availableLights; i != availableLights + nbLights; i++) {
+            pthread_mutex_lock(&i->pendingMutex);
+            bool pending = i->pending;
+            if (pending) {
+                state = i->pendingState;
+                i->pending = false;
+            }
+            pthread_mutex_unlock(&i->pendingMutex);
+
+            if (pending && (applyLightState(&*i, state) != EX_NONE)) {
+                LOG(ERROR) << "Cannot apply state of light " << i->hwLight.id;
+            }
+        }
+
+        pthread_mutex_lock(&applyMutex);
+        appliedSeq = seq;
+        pthread_cond_broadcast(&flushCond);
+        pthread_mutex_unlock(&applyMutex);
+    }
+}
+
+/**
+ * Play a keyframe pattern on a light, until the next state request
+ * @param id = light id
+ * @param color = RGB color value, dimmed by the keyframe levels
+ * @param frames = keyframes
+ * @param nbFrames = number of keyframes
+ * @param repeat = number of plays, 0 forever
+ * @return EX_NONE if success, exception code otherwise
+ */
+int Lights::setLightPattern(int id, int color, const LightsKeyframe* frames, int nbFrames,
+                            int repeat)
+{
+    if (!(0 <= id && id < nbLights) ||
+        (availableLights[id].lightsPattern == nullptr)) {
+        LOG(ERROR) << "Light id " << (int32_t)id << " cannot play a pattern.";
+        return EX_UNSUPPORTED_OPERATION;
+    }
+
+    HwLightConfig* config = &availableLights[id];
+
+    /* pending states were requested before the pattern */
+    flush();
+
+    config->led->lockWrite();
+    int previous = config->compositor->getOwner();
+    int owner = config->compositor->setLit(id, (color & 0x00FFFFFF) != 0);
+    if (owner != id) {
+        config->compositor->setLit(id, (config->state.color & 0x00FFFFFF) != 0);
+        config->led->unlockWrite();
+        LOG(ERROR) << "Light id " << id << " is masked, pattern not played";
+        return EX_ILLEGAL_STATE;
+    }
+    if (previous >= 0) {
+        stopOutput(&availableLights[previous]);
+    }
+    if (config->lightsRamp != nullptr) {
+        config->lightsRamp->stop();
+    }
+
+    config->backend = config->lightsPattern->start(color, frames, nbFrames, repeat);
+    config->flashMode = FlashMode::HARDWARE;
+    config->state.color = color;
+    config->state.flashMode = FlashMode::HARDWARE;
+    config->state.flashOnMs = 0;
+    config->state.flashOffMs = 0;
+    config->led->unlockWrite();
+
+    if (config->backend == LightsBackend::NONE) {
+        LOG(ERROR) << "Invalid pattern for light id " << id;
+        return EX_ILLEGAL_ARGUMENT;
+    }
+    return EX_NONE;
+}
+
+/**
+ * Wait until every state published so far is applied. No-op if the
+ * asynchronous apply is disabled.
+ */
+void Lights::flush()
+{
+    if (!asyncApply) {
+        return;
+    }
+
+    pthread_mutex_lock(&applyMutex);
+    uint64_t seq = publishedSeq;
+    while (appliedSeq < seq) {
+        pthread_cond_wait(&flushCond, &applyMutex);
+    }
+    pthread_mutex_unlock(&applyMutex);
 }
 
 ScopedAStatus Lights::getLights(std::vector<HwLight>* lights) {
     LOG(INFO) << "Lights reporting supported lights";
 
-    for (auto i = availableLights.begin(); i != availableLights.end(); i++) {
+    for (HwLightConfig* i = availableLights; i != availableLights + nbLights; i++) {
         lights->push_back(i->hwLight);
     }
 
     return ScopedAStatus::ok();
 }
 
+binder_status_t Lights::dump(int fd, const char** args, uint32_t numArgs) {
+    bool trace = false;
+
+    for (uint32_t i = 0; i < numArgs; i++) {
+        if (strcmp(args[i], "--flush") == 0) {
+            flush();
+        } else if (strcmp(args[i], "--trace") == 0) {
+            trace = true;
+        }
+    }
+
+    dprintf(fd, "Lights:\n");
+    dprintf(fd, "  startup: discovery=%lldus probe=%lldus registered=%lldus warm-up=%lldus\n",
+            (long long)(discoveryTime / 1000), (long long)(probeTime / 1000),
+            (long long)(registerTime / 1000), (long long)(warmUpTime / 1000));
+    dprintf(fd, "  rejected calls (invalid id): %llu\n",
+            (unsigned long long)rejectedCalls.load(std::memory_order_relaxed));
+    dprintf(fd, "  compositor: masked requests=%llu unchanged outputs=%llu\n",
+            (unsigned long long)maskedRequests.load(std::memory_order_relaxed),
+            (unsigned long long)unchangedOutputs.load(std::memory_order_relaxed));
+    dprintf(fd, "  requests deferred (device absent): %llu\n",
+            (unsigned long long)deferredRequests.load(std::memory_order_relaxed));
+    batchStats.dump(fd, "setLightStates");
+    if (asyncApply) {
+        pthread_mutex_lock(&applyMutex);
+        dprintf(fd, "  async apply: published=%llu applied=%llu coalesced=%llu\n",
+                (unsigned long long)publishedSeq, (unsigned long long)appliedSeq,
+                (unsigned long long)coalescedUpdates.load(std::memory_order_relaxed));
+        pthread_mutex_unlock(&applyMutex);
+    }
+
+    for (HwLightConfig* i = availableLights; i != availableLights + nbLights; i++) {
+        /* snapshot under the write lock, print without it: the counters
+           are relaxed atomics, and a slow reader must not stall updates */
+        i->led->lockWrite();
+        FlashMode flashMode = i->flashMode;
+        LightsBackend backend = i->backend;
+        HwLightState state = i->state;
+        bool owner = (i->compositor->getOwner() == i->hwLight.id);
+        i->led->unlockWrite();
+
+        dprintf(fd, "  light %d: type=%s ordinal=%d device=%s flash=%s backend=%s\n",
+                i->hwLight.id, LightsUtils::getLightTypeName(i->hwLight.type), i->hwLight.ordinal,
+                i->led->getName(),
+                LightsUtils::getFlashModeName(flashMode),
+                LightsUtils::getBackendName(backend));
+        dprintf(fd, "    state: color=0x%08x flash=%s on=%dms off=%dms output=%s\n",
+                (uint32_t)state.color, LightsUtils::getFlashModeName(state.flashMode),
+                state.flashOnMs, state.flashOffMs, owner ? "owner" : "masked");
+        i->stats.dump(fd, "setLightState");
+        if (i->lightsFlash != nullptr) {
+            i->lightsFlash->dump(fd);
+        }
+        if (i->lightsRamp != nullptr) {
+            i->lightsRamp->dump(fd);
+        }
+        if (i->lightsPattern != nullptr) {
+            i->lightsPattern->dump(fd);
+        }
+    }
+
+    dprintf(fd, "  no device for:");
+    for (auto i = missingLights.begin(); i != missingLights.end(); i++) {
+        dprintf(fd, " %s", LightsUtils::getLightTypeName(*i));
+    }
+    dprintf(fd, "\n");
+
+    LightsUtils::dump(fd);
+    LightsScheduler::getInstance()->dump(fd);
+    if (hotplug != nullptr) {
+        hotplug->dump(fd);
+    }
+
+    if (trace) {
+        LightsTrace::dump(fd);
+    }
+
+    return STATUS_OK;
+}
+
 /**
  * Check lights flash parameters
  * @param state pointer to the state to check
@@ -173,22 +758,90 @@ int Lights::checkFlashParams(const HwLightState& state)
 }
 
 /**
- * Add light in list
+ * Add light in the table, in place: the slot holds mutexes and atomics
  * @param type
  * @param ordinal
+ * @param led = physical device
+ * @return 0 if success, error code otherwise (table or device compositor full)
  */
-void Lights::addLight(LightType const type, int const ordinal) {
-    HwLightConfig config{};
+int Lights::addLight(LightType const type, int const ordinal, LightsLed* led) {
+    if (nbLights >= LIGHTS_MAX_LIGHTS) {
+        return -1;
+    }
+
+    HwLightConfig* config = &availableLights[nbLights];
+
+    config->hwLight.id = nbLights;
+    config->hwLight.type = type;
+    config->hwLight.ordinal = ordinal;
+
+    /* one compositor per device, joined first: a light it cannot arbitrate
+       is refused before anything is allocated */
+    config->compositor = nullptr;
+    for (int id = 0; id < nbLights; id++) {
+        if (availableLights[id].led == led) {
+            config->compositor = availableLights[id].compositor;
+        }
+    }
+    if (config->compositor == nullptr) {
+        config->compositor = new LightsCompositor();
+    }
+    if (config->compositor->addInput(config->hwLight.id, type) != 0) {
+        return -1;
+    }
+
+    config->flashMode = FlashMode::NONE;
+    config->backend = LightsBackend::NONE;
+    config->led = led;
+    pthread_mutex_init(&config->pendingMutex, nullptr);
+    config->pending = false;
+    config->state.color = 0;
+    config->state.flashMode = FlashMode::NONE;
+    /* allocated here to keep setLightState free of heap allocation */
+    config->lightsFlash = nullptr;
+    config->lightsPattern = nullptr;
+    if (type != LightType::BACKLIGHT) {
+        config->lightsFlash = new LightsFlash(config->hwLight, led);
+        config->lightsPattern = new LightsPattern(config->hwLight, led,
+                ::android::base::GetIntProperty("ro.vendor.lights.ramp_rate_hz",
+                                                RAMP_RATE_HZ_DEFAULT, 1, 1000));
+
+        /* vendor pattern played in HARDWARE flash mode */
+        char property[64];
+        int size = snprintf(property, sizeof(property), "ro.vendor.lights.pattern.%s",
+                            LightsUtils::getLightTypeName(type));
+        for (int i = size - strlen(LightsUtils::getLightTypeName(type)); i < size; i++) {
+            property[i] = tolower(property[i]);
+        }
+        std::string spec = ::android::base::GetProperty(property, "");
+        LightsKeyframe frames[LightsPattern::MAX_KEYFRAMES];
+        int nbFrames = spec.empty() ? 0 :
+                LightsPattern::parse(spec.c_str(), frames, LightsPattern::MAX_KEYFRAMES);
+        if (nbFrames > 0) {
+            config->lightsPattern->setPreset(frames, nbFrames);
+        }
+    }
 
-    config.hwLight.id = availableLights.size();
-    config.hwLight.type = type;
-    config.hwLight.ordinal = ordinal;
+    config->outputValid = false;
 
-    config.writeMutex = PTHREAD_MUTEX_INITIALIZER;
-    config.flashMode = FlashMode::NONE;
-    config.lightsFlash = nullptr;
+    config->rampMs = ::android::base::GetIntProperty(
+            (type == LightType::BACKLIGHT) ? "ro.vendor.lights.backlight.ramp_ms"
+                                           : "ro.vendor.lights.ramp_ms", 0, 0, MAX_RAMP_MS);
+    config->lightsRamp = nullptr;
+    if (config->rampMs > 0) {
+        for (int id = 0; id < nbLights; id++) {
+            if (availableLights[id].led == led) {
+                config->lightsRamp = availableLights[id].lightsRamp;
+            }
+        }
+        if (config->lightsRamp == nullptr) {
+            config->lightsRamp = new LightsRamp(led, ::android::base::GetIntProperty(
+                    "ro.vendor.lights.ramp_rate_hz", RAMP_RATE_HZ_DEFAULT, 1, 1000));
+        }
+    }
 
-    availableLights.emplace_back(config);
+    nbLights++;
+    return 0;
 }
 
 }  // namespace light
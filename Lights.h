@@ -17,10 +17,17 @@
 #pragma once
 
 #include "LightsUtils.h"
+#include "LightsCompositor.h"
+#include "LightsConfig.h"
 #include "LightsFlash.h"
+#include "LightsHotplug.h"
+#include "LightsPattern.h"
+#include "LightsStats.h"
 
 #include <aidl/android/hardware/light/BnLights.h>
 
+#include <atomic>
+
 namespace aidl {
 namespace android {
 namespace hardware {
@@ -36,22 +43,105 @@ using ::aidl::android::hardware::light::FlashMode;
 using ::aidl::android::hardware::light::LightsFlash;
 using ::aidl::android::hardware::light::LightsUtils;
 
-struct HwLightConfig {
+/**
+ * Slot of the light table. The fields up to the compositor are set at
+ * startup, the others follow the requests of the light. Each slot starts
+ * on a cache line and fills whole lines, so that updates of different
+ * lights never share one.
+ */
+struct alignas(LIGHTS_CACHE_LINE_SIZE) HwLightConfig {
   HwLight hwLight;
-  FlashMode flashMode;
+  /* device, its write lock serializes the lights sharing it */
+  LightsLed* led;
   LightsFlash* lightsFlash;
-  pthread_mutex_t writeMutex;
+  LightsPattern* lightsPattern;
+  /* transition of the device, shared by the lights on it, nullptr if disabled */
+  LightsRamp* lightsRamp;
+  int rampMs;
+  /* arbitration of the lights sharing the device */
+  LightsCompositor* compositor;
+  FlashMode flashMode;
+  LightsBackend backend;
+  /* last state requested */
+  HwLightState state;
+  /* state driving the device, valid while the light owns the output */
+  HwLightState output;
+  bool outputValid;
+  LightsCallStats stats;
+  /* latest state not applied yet, asynchronous apply only */
+  pthread_mutex_t pendingMutex;
+  HwLightState pendingState;
+  bool pending;
+};
+
+static_assert(sizeof(HwLightConfig) % LIGHTS_CACHE_LINE_SIZE == 0,
+              "light slots must not share a cache line");
+/* a flash, a pattern and a device transition per light at most */
+static_assert(LightsScheduler::MAX_TASKS >= 3 * LIGHTS_MAX_LIGHTS,
+              "scheduler heap too small for the light table");
+static_assert(LightsCompositor::MAX_INPUTS >= LIGHTS_MAX_LIGHTS,
+              "compositor too small for the light table");
+
+/**
+ * Light update of a batch, see Lights::setLightStates
+ */
+struct LightsUpdate {
+  int id;
+  HwLightState state;
 };
 
-class Lights : public BnLights {
+class Lights : public BnLights, public LightsHotplugListener {
     private:
-        std::vector<HwLightConfig> availableLights;
+        std::vector<LightType> missingLights;
+        int nbLights = 0;
+        bool asyncApply = false;
+        pthread_mutex_t applyMutex = PTHREAD_MUTEX_INITIALIZER;
+        pthread_cond_t applyCond = PTHREAD_COND_INITIALIZER;
+        pthread_cond_t flushCond = PTHREAD_COND_INITIALIZER;
+        uint64_t publishedSeq = 0;
+        uint64_t appliedSeq = 0;
+        HwLightConfig availableLights[LIGHTS_MAX_LIGHTS];
+        /* after the table, away from the fields read by every call */
+        std::atomic<uint64_t> coalescedUpdates{0};
+        std::atomic<uint64_t> rejectedCalls{0};
+        std::atomic<uint64_t> maskedRequests{0};
+        std::atomic<uint64_t> unchangedOutputs{0};
+        std::atomic<uint64_t> deferredRequests{0};
+        LightsCallStats batchStats;
+        LightsHotplug* hotplug = nullptr;
+        /* startup steps, in nanoseconds */
+        int64_t discoveryTime = 0;
+        int64_t probeTime = 0;
+        int64_t registerTime = 0;
+        int64_t warmUpTime = 0;
+
         int checkFlashParams(const HwLightState& state);
-        void addLight(LightType const type, int const ordinal);
+        int checkLightState(int id, const HwLightState& state);
+        int applyLightState(HwLightConfig* config, const HwLightState& state);
+        int applyLightStateLocked(HwLightConfig* config, const HwLightState& state);
+        int applyOutput(HwLightConfig* config, const HwLightState& state);
+        void stopOutput(HwLightConfig* config);
+        static bool isSameState(const HwLightState& a, const HwLightState& b);
+        void storePendingState(HwLightConfig* config, const HwLightState& state);
+        void notifyApply();
+        int addLight(LightType const type, int const ordinal, LightsLed* led);
     public:
+        static int const MAX_BATCH = 32;
+
         Lights();
+        void setRegisterTime(int64_t ns) { registerTime = ns; }
+        void warmUp();
+        int startHotplug(int fd);
+        void onLedAdded(LightsLed* led) override;
+        void onLedRemoved(LightsLed* led) override;
+        void applyRoutine();
+        void flush();
+        int setLightStates(const LightsUpdate* updates, int nbUpdates);
+        int setLightPattern(int id, int color, const LightsKeyframe* frames, int nbFrames,
+                            int repeat);
         ScopedAStatus setLightState(int id, const HwLightState& state) override;
         ScopedAStatus getLights(std::vector<HwLight>* types) override;
+        binder_status_t dump(int fd, const char** args, uint32_t numArgs) override;
 };
 
 }  // namespace light
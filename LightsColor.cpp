@@ -0,0 +1,113 @@
+/*
+ * Copyright (C) 2024 STMicroelectronics
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <math.h>
+#include <pthread.h>
+#include <string.h>
+
+#include "LightsColor.h"
+
+#include <android-base/logging.h>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace light {
+
+/* curve values are 16.16 fixed point, 1.0 is full brightness */
+static int const CURVE_SHIFT = 16;
+static uint32_t const CURVE_ONE = 1U << CURVE_SHIFT;
+static int const NB_CURVES = 3;
+
+static const char* const CURVE_NAMES[NB_CURVES] = {
+    "linear", "gamma", "perceptual",
+};
+
+static pthread_once_t sCurvesOnce = PTHREAD_ONCE_INIT;
+static uint32_t sCurves[NB_CURVES][LightsColorLut::LUMA_LEVELS];
+
+static void buildCurves()
+{
+    for (int i = 0; i < LightsColorLut::LUMA_LEVELS; i++) {
+        double x = i / (double)(LightsColorLut::LUMA_LEVELS - 1);
+        double lstar = x * 100.0;
+        double y = (lstar > 8.0) ? pow((lstar + 16.0) / 116.0, 3.0) : lstar / 903.3;
+
+        sCurves[static_cast<int>(LightsCurve::LINEAR)][i] = lround(x * CURVE_ONE);
+        sCurves[static_cast<int>(LightsCurve::GAMMA)][i] = lround(pow(x, 2.2) * CURVE_ONE);
+        sCurves[static_cast<int>(LightsCurve::PERCEPTUAL)][i] = lround(y * CURVE_ONE);
+    }
+}
+
+/**
+ * Scale a curve to the device max brightness
+ * @param curve = normalized curve
+ * @param max = max brightness
+ */
+void LightsColorLut::fill(const uint32_t* curve, long int max)
+{
+    for (int i = 0; i < LUMA_LEVELS; i++) {
+        mTable[i] = ((uint64_t)curve[i] * (uint64_t)max + (CURVE_ONE >> 1)) >> CURVE_SHIFT;
+    }
+}
+
+/**
+ * Build the table for a device
+ * @param curve = transfer curve
+ * @param maxBrightness = max brightness of the device
+ */
+void LightsColorLut::build(LightsCurve curve, long int maxBrightness)
+{
+    pthread_once(&sCurvesOnce, buildCurves);
+
+    int index = static_cast<int>(curve);
+    if ((index < 0) || (index >= NB_CURVES)) {
+        index = static_cast<int>(LightsCurve::LINEAR);
+    }
+    if (maxBrightness < 0) {
+        maxBrightness = 0;
+    }
+    mMaxBrightness = maxBrightness;
+
+    fill(sCurves[index], maxBrightness);
+}
+
+/**
+ * Get a curve from its name
+ * @param name = curve name
+ * @return curve, LightsCurve::LINEAR if unknown
+ */
+LightsCurve LightsColorLut::parseCurve(const char* name)
+{
+    for (int i = 0; i < NB_CURVES; i++) {
+        if (strcmp(name, CURVE_NAMES[i]) == 0) {
+            return static_cast<LightsCurve>(i);
+        }
+    }
+    LOG(ERROR) << "Unknown brightness curve " << name << ", using linear";
+    return LightsCurve::LINEAR;
+}
+
+const char* LightsColorLut::getCurveName(LightsCurve curve)
+{
+    int index = static_cast<int>(curve);
+    return ((index >= 0) && (index < NB_CURVES)) ? CURVE_NAMES[index] : "UNKNOWN";
+}
+
+}  // namespace light
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
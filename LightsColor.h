@@ -0,0 +1,94 @@
+/*
+ * Copyright (C) 2024 STMicroelectronics
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace light {
+
+/**
+ * Transfer curve from the color luminance to the device brightness
+ */
+enum class LightsCurve {
+    LINEAR,     // brightness proportional to luminance
+    GAMMA,      // gamma 2.2
+    PERCEPTUAL, // CIE 1976 lightness (L*) inverse
+};
+
+/**
+ * Color to brightness lookup table of one device.
+ *
+ * The table is built once for the device max brightness, so that a color
+ * conversion is the luminance computation and a single lookup. The curve
+ * is scaled to max brightness, not clamped, so that the whole range of
+ * the device is used.
+ */
+class LightsColorLut {
+    public:
+        static int const LUMA_LEVELS = 256;
+    private:
+        uint32_t mTable[LUMA_LEVELS] = {};
+        long int mMaxBrightness = 0;
+
+        void fill(const uint32_t* curve, long int max);
+    public:
+        void build(LightsCurve curve, long int maxBrightness);
+
+        /**
+         * Get the luminance of a RGB color, weights 77/150/29 (sum 256)
+         * @param color = RGB color value
+         * @return luminance, 0..255
+         */
+        static inline uint32_t getLuma(int color) {
+            return ((77 * ((color >> 16) & 0xff)) + (150 * ((color >> 8) & 0xff)) +
+                    (29 * (color & 0xff))) >> 8;
+        }
+
+        /**
+         * Get the device brightness of a color
+         * @param color = RGB color value
+         * @return brightness, 0..max brightness
+         */
+        inline long int getBrightness(int color) const {
+            color = color & 0x00FFFFFF;
+            /* legacy: color 1 means full brightness */
+            if (color == 1) {
+                return mMaxBrightness;
+            }
+            return mTable[getLuma(color)];
+        }
+
+        /**
+         * Get the device brightness of one color channel
+         * @param level = channel level, 0..255
+         * @return brightness, 0..max brightness
+         */
+        inline long int getLevelBrightness(uint32_t level) const {
+            return mTable[level & 0xff];
+        }
+
+        static LightsCurve parseCurve(const char* name);
+        static const char* getCurveName(LightsCurve curve);
+};
+
+}  // namespace light
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
@@ -0,0 +1,106 @@
+/*
+ * Copyright (C) 2024 STMicroelectronics
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "LightsCompositor.h"
+
+#include <android-base/logging.h>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace light {
+
+/**
+ * Get the priority of a light type on a shared device
+ * @param type = light type
+ * @return priority, highest wins
+ */
+int LightsCompositor::getPriority(LightType type)
+{
+    switch (type) {
+        case LightType::ATTENTION:
+            return 6;
+        case LightType::NOTIFICATIONS:
+            return 5;
+        case LightType::BATTERY:
+            return 4;
+        case LightType::BLUETOOTH:
+        case LightType::WIFI:
+        case LightType::MICROPHONE:
+            return 3;
+        case LightType::KEYBOARD:
+        case LightType::BUTTONS:
+            return 2;
+        default:
+            return 1;
+    }
+}
+
+/**
+ * Add a light to the device
+ * @param id = light id
+ * @param type = light type
+ * @return 0 if success, error code otherwise
+ */
+int LightsCompositor::addInput(int id, LightType type)
+{
+    if (mNbInputs >= MAX_INPUTS) {
+        LOG(ERROR) << "Too many lights on one device";
+        return -1;
+    }
+    mInputs[mNbInputs].id = id;
+    mInputs[mNbInputs].priority = getPriority(type);
+    mInputs[mNbInputs].lit = false;
+    mNbInputs++;
+    return 0;
+}
+
+/**
+ * Update the request of a light and elect the output owner
+ * @param id = light id
+ * @param lit = the requested state emits light
+ * @return id of the light owning the output
+ */
+int LightsCompositor::setLit(int id, bool lit)
+{
+    int owner = -1;
+    int priority = -1;
+
+    for (int i = 0; i < mNbInputs; i++) {
+        if (mInputs[i].id == id) {
+            mInputs[i].lit = lit;
+        }
+        if (mInputs[i].lit && (mInputs[i].priority > priority)) {
+            owner = mInputs[i].id;
+            priority = mInputs[i].priority;
+        }
+    }
+
+    /* nothing lit: the requester turns the device off */
+    if (owner < 0) {
+        owner = id;
+    }
+    if (owner != mOwner) {
+        mOwnerChanges++;
+        mOwner = owner;
+    }
+    return owner;
+}
+
+}  // namespace light
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) 2024 STMicroelectronics
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "LightsConfig.h"
+
+#include <stdint.h>
+
+#include <aidl/android/hardware/light/BnLights.h>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace light {
+
+using ::aidl::android::hardware::light::LightType;
+
+/**
+ * Arbitration of the logical lights sharing one physical device.
+ *
+ * The output of the device belongs to the highest priority light whose
+ * requested state is lit (ATTENTION over NOTIFICATIONS over BATTERY...),
+ * the other lights are masked and only keep their request. When no light
+ * is lit, the last requester owns the (off) output. Only the owner drives
+ * the device, so there is a single writer per device. Not thread safe:
+ * used under the device write mutex.
+ */
+class LightsCompositor {
+    public:
+        /* every light of the table may share one device */
+        static int const MAX_INPUTS = LIGHTS_MAX_LIGHTS;
+    private:
+        struct Input {
+            int id;
+            int priority;
+            bool lit;
+        };
+        Input mInputs[MAX_INPUTS];
+        int mNbInputs = 0;
+        int mOwner = -1;
+        uint64_t mOwnerChanges = 0;
+    public:
+        static int getPriority(LightType type);
+        int addInput(int id, LightType type);
+        int setLit(int id, bool lit);
+        int getOwner() const { return mOwner; }
+        int getNbInputs() const { return mNbInputs; }
+        uint64_t getOwnerChanges() const { return mOwnerChanges; }
+};
+
+}  // namespace light
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
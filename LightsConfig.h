@@ -0,0 +1,32 @@
+/*
+ * Copyright (C) 2024 STMicroelectronics
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#pragma once
+
+/*
+ * Build time sizes, a board may override them with cflags (see Android.bp)
+ */
+
+#ifndef LIGHTS_MAX_LIGHTS
+/* size of the light table */
+#define LIGHTS_MAX_LIGHTS 16
+#endif
+
+#ifndef LIGHTS_CACHE_LINE_SIZE
+/* alignment keeping data updated from different threads apart */
+#define LIGHTS_CACHE_LINE_SIZE 64
+#endif
@@ -16,6 +16,7 @@
 
 #include <errno.h>
 #include <fcntl.h>
+#include <limits.h>
 #include <pthread.h>
 #include <stdint.h>
 #include <stdlib.h>
@@ -24,8 +25,10 @@
 #include <vector>
 
 #include "LightsFlash.h"
+#include "LightsTrace.h"
 
 #include <android-base/logging.h>
+#include <android-base/properties.h>
 
 namespace aidl {
 namespace android {
@@ -33,18 +36,17 @@ namespace hardware {
 namespace light {
 
 static int64_t const ONE_MS_IN_NS = 1000000LL;
-static int64_t const ONE_S_IN_NS = 1000000000LL;
 
-LightsFlash::LightsFlash(HwLight light) : mHwLight{light}
+LightsFlash::LightsFlash(HwLight light, LightsLed* led) : mHwLight{light}, mLed{led}
 {
-    if (initLightSyncResources() != 0) {
-        LOG(ERROR) << "Cannot initialize the pthread";
-    }
+    mAnchored = ::android::base::GetBoolProperty("ro.vendor.lights.flash.anchored", true);
+    LightsScheduler::initMutex(&mFlashMutex);
 }
 
 LightsFlash::~LightsFlash()
 {
     stop();
+    pthread_mutex_destroy(&mFlashMutex);
 }
 
 /**
@@ -53,176 +55,258 @@ LightsFlash::~LightsFlash()
  */
 void LightsFlash::setLightState(HwLightState state)
 {
+    pthread_mutex_lock(&mFlashMutex);
     mHwLightState = state;
-    mState = LightsFlashState::INITIALIZED;
-}
-
-/**
- * Initialize light synchronization resources
- * @param cond what condition variable to initialize
- * @param signal_mutex what mutex (associated with the condvar) to initialize
- * @return 0 if success, error code otherwise
- */
-int LightsFlash::initLightSyncResources()
-{
-    int ret = 0;
-    pthread_condattr_t condattr;
-
-    ret = pthread_condattr_init(&condattr);
-    if (ret != 0) {
-        LOG(ERROR) << "Cannot initialize the pthread condattr";
-        return ret;
+    if (mState != LightsFlashState::STARTED) {
+        mState = LightsFlashState::INITIALIZED;
     }
+    pthread_mutex_unlock(&mFlashMutex);
+}
 
-    ret = pthread_condattr_setclock(&condattr, CLOCK_MONOTONIC);
-    if (ret != 0) {
-        LOG(ERROR) << "Cannot set the clock of condattr to monotonic";
-        goto destroy_condattr;
-    }
+int LightsFlash::start() {
+    int64_t deadline;
+    int ret;
 
-    ret = pthread_cond_init(&mFlashCond, &condattr);
-    if (ret != 0) {
-        LOG(ERROR) << "Cannot intialize the pthread structure";
-        goto destroy_condattr;
+    pthread_mutex_lock(&mFlashMutex);
+    if ((mState == LightsFlashState::INITIALIZED) || (mState == LightsFlashState::STOPPED)) {
+        LOG(VERBOSE) << "Start flash routine for light type "
+                     << LightsUtils::getLightTypeName(mHwLight.type);
+        mColor = mHwLightState.color;
+        mStartTime = LightsScheduler::getTimestampMonotonic();
+        mTargetTime = mStartTime;
+        mState = LightsFlashState::STARTED;
+        mStarts.fetch_add(1, std::memory_order_relaxed);
+        LightsTrace::record(LightsTraceEvent::FLASH_START, mHwLight.id,
+                            mHwLightState.flashOnMs);
     }
+    deadline = mTargetTime;
+    pthread_mutex_unlock(&mFlashMutex);
 
-    ret = pthread_mutex_init(&mFlashSignalMutex, nullptr);
+    ret = LightsScheduler::getInstance()->schedule(this, deadline);
     if (ret != 0) {
-        LOG(ERROR) << "Cannot initialize the mutex associated with the pthread cond";
-        goto destroy_cond;
+        pthread_mutex_lock(&mFlashMutex);
+        mState = LightsFlashState::STOPPED;
+        pthread_mutex_unlock(&mFlashMutex);
     }
-
-    pthread_condattr_destroy(&condattr);
     return ret;
-
-destroy_cond:
-    pthread_cond_destroy(&mFlashCond);
-destroy_condattr:
-    pthread_condattr_destroy(&condattr);
-    return ret;
-}
-
-static void* execRoutine(void *arg) {
-    LightsFlash* _this=static_cast<LightsFlash*>(arg);
-    _this->flashRoutine();
-    return nullptr;
 }
 
-int LightsFlash::start() {
-    int ret = 0;
-    if ((mState == LightsFlashState::INITIALIZED) || (mState == LightsFlashState::STOPPED)) {
-        ret = pthread_create(&mFlashThread, nullptr, execRoutine, this);
-        if (ret == 0) {
-            mState = LightsFlashState::STARTED;
+/**
+ * Change the color and delays of a flash running, from its next edge.
+ * The edge already scheduled is kept, the cycle is anchored on it.
+ * @param state = new flash state
+ * @return 0 if retimed, -1 if not flashing or if steady (zero duration
+ *         phase) before or after: the flash must be started again
+ */
+int LightsFlash::retime(const HwLightState& state) {
+    int64_t start = LightsScheduler::getTimestampMonotonic();
+    int ret = -1;
+
+    pthread_mutex_lock(&mFlashMutex);
+    if ((mState == LightsFlashState::STARTED) &&
+        (mHwLightState.flashOnMs > 0) && (mHwLightState.flashOffMs > 0) &&
+        (state.flashOnMs > 0) && (state.flashOffMs > 0)) {
+        mHwLightState = state;
+        if (!mAnchored) {
+            /* color of the next edge */
+            mColor = (mColor != 0) ? state.color : 0;
+        } else if (mTargetTime != mStartTime) {
+            /* next edge switches off if the light is on, else starts a cycle */
+            mStartTime = (mColor != 0) ? mTargetTime - state.flashOnMs * ONE_MS_IN_NS
+                                       : mTargetTime;
         }
+        LightsTrace::record(LightsTraceEvent::FLASH_RETIME, mHwLight.id, state.flashOnMs);
+        ret = 0;
+    }
+    pthread_mutex_unlock(&mFlashMutex);
+
+    if (ret == 0) {
+        mRetimeLatency.record(LightsScheduler::getTimestampMonotonic() - start);
     }
     return ret;
 }
 
+/**
+ * Stop flashing. Once returned, no more edge is written: an edge in
+ * progress holds the flash mutex, later ones see the STOPPED state.
+ */
 void LightsFlash::stop() {
+    int64_t start = LightsScheduler::getTimestampMonotonic();
+    bool stopped = false;
+
+    pthread_mutex_lock(&mFlashMutex);
     if (mState == LightsFlashState::STARTED) {
-        LOG(INFO) << "Stop flash routine for light type "
-                  << LightsUtils::getLightTypeName(mHwLight.type);
+        LOG(VERBOSE) << "Stop flash routine for light type "
+                     << LightsUtils::getLightTypeName(mHwLight.type);
+        mState = LightsFlashState::STOPPED;
+        LightsScheduler::getInstance()->cancel(this);
+        LightsTrace::record(LightsTraceEvent::FLASH_STOP, mHwLight.id, 0);
+        stopped = true;
+        mStops.fetch_add(1, std::memory_order_relaxed);
+    }
+    pthread_mutex_unlock(&mFlashMutex);
 
-        pthread_mutex_lock(&mFlashSignalMutex);
-        mHwLightState.flashMode = FlashMode::NONE;
-        pthread_cond_signal(&mFlashCond);
-        pthread_mutex_unlock(&mFlashSignalMutex);
-        pthread_join(mFlashThread, nullptr);
+    if (stopped) {
+        mStopLatency.record(LightsScheduler::getTimestampMonotonic() - start);
     }
 }
 
 /**
- * Get current timestamp in nanoseconds
- * @return time in nanoseconds
+ * Get the index of the last edge due at a given time, counted from start
+ * @param time = monotonic time in nanoseconds
+ * @return edge index
  */
-int64_t LightsFlash::getTimestampMonotonic()
-{
-    struct timespec ts = {0, 0};
-
-    if (!clock_gettime(CLOCK_MONOTONIC, &ts)) {
-        return ONE_S_IN_NS * ts.tv_sec + ts.tv_nsec;
-    }
+int64_t LightsFlash::getEdgeIndex(int64_t time) {
+    int64_t on = mHwLightState.flashOnMs * ONE_MS_IN_NS;
+    int64_t cycle = on + mHwLightState.flashOffMs * ONE_MS_IN_NS;
+    int64_t elapsed = time - mStartTime;
 
-    return -1;
+    return 2 * (elapsed / cycle) + (((elapsed % cycle) >= on) ? 1 : 0);
 }
 
 /**
- * Populates a timespec data structure from a int64_t timestamp
- * @param out what timespec to populate
- * @param target_ns timestamp in nanoseconds
+ * Compute the next edge from the flash start time, skipping the missed ones
+ * @param now = current monotonic time in nanoseconds
+ * @return next edge deadline, -1 on overflow
  */
-void LightsFlash::setTimestamp(struct timespec *out, int64_t target_ns)
-{
-    out->tv_sec  = target_ns / ONE_S_IN_NS;
-    out->tv_nsec = target_ns % ONE_S_IN_NS;
+int64_t LightsFlash::nextAnchoredEdge(int64_t now) {
+    int64_t on = mHwLightState.flashOnMs * ONE_MS_IN_NS;
+    int64_t cycle = on + mHwLightState.flashOffMs * ONE_MS_IN_NS;
+    int64_t elapsed = now - mStartTime;
+    int64_t cycleStart = mStartTime + (elapsed / cycle) * cycle;
+    int64_t next;
+
+    /* light is on during [cycleStart, cycleStart + on) */
+    if (now - cycleStart < on) {
+        mColor = mHwLightState.color;
+        next = cycleStart + on;
+    } else {
+        mColor = 0;
+        next = cycleStart + cycle;
+    }
+
+    /* check for overflow */
+    if (next < now) {
+        LOG(ERROR) << "Timestamp overflow";
+        return -1;
+    }
+
+    return next;
 }
 
-void LightsFlash::flashRoutine() {
-    int color = 0, ret = 0, reqColor = 0;
-    struct timespec targetTime;
-    int64_t timestamp, period;
+/**
+ * Compute the next edge from the current time
+ * @param now = current monotonic time in nanoseconds
+ * @return next edge deadline, -1 on overflow
+ */
+int64_t LightsFlash::nextRelativeEdge(int64_t now) {
+    int64_t period;
+
+    if (mColor) {
+        mColor = 0;
+        period = mHwLightState.flashOnMs * ONE_MS_IN_NS;
+    } else {
+        mColor = mHwLightState.color;
+        period = mHwLightState.flashOffMs * ONE_MS_IN_NS;
+    }
 
-    if (mState != LightsFlashState::STARTED) {
-        LOG(ERROR) << "start flash routing while in bad state";
-        return;
+    /* check for overflow */
+    if (now > LLONG_MAX - period) {
+        LOG(ERROR) << "Timestamp overflow";
+        return -1;
     }
 
-    LOG(INFO) << "Start flash routine for light type "
-              << LightsUtils::getLightTypeName(mHwLight.type);
+    return now + period;
+}
 
-    const char* name = LightsUtils::getLedName(mHwLight.type);
-    if (name == nullptr) {
-        LOG(ERROR) << "Light type unknown"; 
-        return;
-    }
+/**
+ * Write one flash edge. The flash stops on a write error or a deadline
+ * overflow, so that it is not left started without being scheduled.
+ * @param now = current monotonic time in nanoseconds
+ * @return next edge deadline, -1 to stop flashing
+ */
+int64_t LightsFlash::onDeadline(int64_t now) {
+    int64_t next = -1;
+    int color;
 
-    pthread_mutex_lock(&mFlashSignalMutex);
+    pthread_mutex_lock(&mFlashMutex);
+    if (mState != LightsFlashState::STARTED) {
+        goto mutex_unlock;
+    }
 
-    reqColor = mHwLightState.color;
-    color = reqColor;
+    mJitter.record(now - mTargetTime);
 
-    /* Light flashing loop */
-    while (mHwLightState.flashMode == FlashMode::TIMED) {
-        ret = LightsUtils::setColorValue(name, color, false);
-        if (ret != 0) {
+    /* a zero duration phase never shows up: keep the light steady */
+    if ((mHwLightState.flashOnMs == 0) || (mHwLightState.flashOffMs == 0)) {
+        color = (mHwLightState.flashOnMs == 0) ? 0 : mHwLightState.color;
+        LightsTrace::record(LightsTraceEvent::FLASH_EDGE, mHwLight.id, color);
+        if (LightsUtils::setColorValue(mLed, color, false) != 0) {
             LOG(ERROR) << "Cannot set light color";
-            goto mutex_unlock;
         }
+        goto mutex_unlock;
+    }
 
-        timestamp = getTimestampMonotonic();
-        if (timestamp < 0) {
-            LOG(ERROR) << "Cannot get time from monotonic clock";
-            goto mutex_unlock;
+    if (mAnchored) {
+        /* edges between the target one and now are skipped */
+        int64_t missed = getEdgeIndex(now) - getEdgeIndex(mTargetTime);
+        if (missed > 0) {
+            mMissedEdges.fetch_add(missed, std::memory_order_relaxed);
         }
+        next = nextAnchoredEdge(now);
+        color = mColor;
+    } else {
+        color = mColor;
+        next = nextRelativeEdge(now);
+    }
 
-        if (color) {
-            color = 0;
-            period = mHwLightState.flashOnMs * ONE_MS_IN_NS;
-        } else {
-            color = reqColor;
-            period = mHwLightState.flashOffMs * ONE_MS_IN_NS;
-        }
+    LightsTrace::record(LightsTraceEvent::FLASH_EDGE, mHwLight.id, color);
+    if (LightsUtils::setColorValue(mLed, color, false) != 0) {
+        LOG(ERROR) << "Cannot set light color";
+        next = -1;
+    }
 
-        /* check for overflow */
-        if (timestamp > LLONG_MAX - period) {
-            LOG(ERROR) << "Timestamp overflow";
-            goto mutex_unlock;
-        }
+    if (next < 0) {
+        /* unscheduled: the next request starts the flash again */
+        mState = LightsFlashState::STOPPED;
+        mStops.fetch_add(1, std::memory_order_relaxed);
+        LightsTrace::record(LightsTraceEvent::FLASH_STOP, mHwLight.id, 0);
+        goto mutex_unlock;
+    }
 
-        timestamp += period;
+    mTargetTime = next;
 
-        /* sleep until target_time or the cond var is signaled */
-        setTimestamp(&targetTime, timestamp);
-        ret = pthread_cond_timedwait(&mFlashCond, &mFlashSignalMutex, &targetTime);
-        if ((ret != 0) && (ret != ETIMEDOUT)) {
-            LOG(ERROR) << "pthread_cond_timedwait returned an error";
-            goto mutex_unlock;
-        }
+mutex_unlock:
+    pthread_mutex_unlock(&mFlashMutex);
+    return next;
+}
+
+/**
+ * Stop, the scheduler could not queue the next edge
+ */
+void LightsFlash::onUnscheduled() {
+    pthread_mutex_lock(&mFlashMutex);
+    if (mState == LightsFlashState::STARTED) {
+        mState = LightsFlashState::STOPPED;
+        mStops.fetch_add(1, std::memory_order_relaxed);
+        LightsTrace::record(LightsTraceEvent::FLASH_STOP, mHwLight.id, 0);
     }
+    pthread_mutex_unlock(&mFlashMutex);
+}
 
-mutex_unlock:
-    pthread_mutex_unlock(&mFlashSignalMutex);
+/**
+ * Print flash timing statistics
+ * @param fd = output file descriptor
+ */
+void LightsFlash::dump(int fd) {
+    dprintf(fd, "    flash timing: %s, missed edges=%llu starts=%llu stops=%llu retimes=%llu\n",
+            mAnchored ? "anchored" : "relative",
+            (unsigned long long)mMissedEdges.load(std::memory_order_relaxed),
+            (unsigned long long)mStarts.load(std::memory_order_relaxed),
+            (unsigned long long)mStops.load(std::memory_order_relaxed),
+            (unsigned long long)mRetimeLatency.getCount());
+    mJitter.dump(fd, "edge jitter");
+    mRetimeLatency.dump(fd, "retime latency");
+    mStopLatency.dump(fd, "stop latency");
 }
 
 }  // namespace light
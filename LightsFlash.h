@@ -17,6 +17,8 @@
 #pragma once
 
 #include "LightsUtils.h"
+#include "LightsScheduler.h"
+#include "LightsStats.h"
 
 #include <aidl/android/hardware/light/BnLights.h>
 
@@ -34,25 +36,51 @@ using ::aidl::android::hardware::light::LightsUtils;
 
 enum LightsFlashState { UNKNOWN, INITIALIZED, STARTED, STOPPED };
 
-class LightsFlash {
+/**
+ * Userspace TIMED flashing of one light, driven by the LightsScheduler
+ * thread: each deadline callback writes one edge and returns the next one.
+ *
+ * In anchored mode (default, ro.vendor.lights.flash.anchored), edges are
+ * placed at start + k * period so that write time and scheduling delay do
+ * not accumulate; edges missed while the thread was late are skipped.
+ * Otherwise the next edge is computed from the time of the current one.
+ *
+ * A flash running is retimed in place: the new color and delays apply
+ * from the next edge, already scheduled, without restarting the flash.
+ * Neither retiming nor stopping waits for the scheduler thread, at most
+ * for an edge being written.
+ */
+class alignas(LIGHTS_CACHE_LINE_SIZE) LightsFlash : public LightsSchedulerTask {
     private:
         LightsFlashState mState = LightsFlashState::UNKNOWN;
         HwLight mHwLight;
         HwLightState mHwLightState;
-        pthread_t mFlashThread;
-        pthread_cond_t mFlashCond;
-        pthread_mutex_t mFlashSignalMutex;
+        pthread_mutex_t mFlashMutex;
+        LightsLed* mLed;
+        int mColor = 0;
+        bool mAnchored;
+        int64_t mStartTime = 0;
+        int64_t mTargetTime = 0;
+        LightsHistogram mJitter;
+        LightsHistogram mRetimeLatency;
+        LightsHistogram mStopLatency;
+        std::atomic<uint64_t> mStarts{0};
+        std::atomic<uint64_t> mStops{0};
+        std::atomic<uint64_t> mMissedEdges{0};
 
-        int initLightSyncResources();
-        void setTimestamp(struct timespec *out, int64_t target_ns);
-        int64_t getTimestampMonotonic();
+        int64_t getEdgeIndex(int64_t time);
+        int64_t nextAnchoredEdge(int64_t now);
+        int64_t nextRelativeEdge(int64_t now);
     public:
-        LightsFlash(HwLight light);
+        LightsFlash(HwLight light, LightsLed* led);
         ~LightsFlash();
         void setLightState(HwLightState state);
         int start();
+        int retime(const HwLightState& state);
         void stop();
-        void flashRoutine();
+        int64_t onDeadline(int64_t now) override;
+        void onUnscheduled() override;
+        void dump(int fd);
 };
 
 }  // namespace light
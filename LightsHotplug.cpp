@@ -0,0 +1,320 @@
+/*
+ * Copyright (C) 2024 STMicroelectronics
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <linux/netlink.h>
+
+#include "LightsHotplug.h"
+#include "LightsScheduler.h"
+#include "LightsUtils.h"
+
+#include <android-base/logging.h>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace light {
+
+static int64_t const ONE_MS_IN_NS = 1000000LL;
+static int const UEVENT_RCVBUF_SIZE = 64 * 1024;
+
+static void* execLoop(void *arg) {
+    LightsHotplug* _this = static_cast<LightsHotplug*>(arg);
+    _this->loop();
+    return nullptr;
+}
+
+/**
+ * Start listening to uevents
+ * @param fd = datagram socket carrying uevents, -1 to open the kernel
+ *             uevent netlink socket
+ * @return 0 if success, error code otherwise
+ */
+int LightsHotplug::start(int fd)
+{
+    pthread_t thread;
+
+    if (mFd >= 0) {
+        LOG(ERROR) << "Lights hotplug already started";
+        return -1;
+    }
+
+    if (fd < 0) {
+        struct sockaddr_nl addr;
+        int on = 1;
+        int size = UEVENT_RCVBUF_SIZE;
+
+        fd = socket(AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC, NETLINK_KOBJECT_UEVENT);
+        if (fd < 0) {
+            PLOG(ERROR) << "Cannot open the uevent socket";
+            return -1;
+        }
+        setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+        /* credentials tell kernel messages from spoofed ones */
+        setsockopt(fd, SOL_SOCKET, SO_PASSCRED, &on, sizeof(on));
+
+        memset(&addr, 0, sizeof(addr));
+        addr.nl_family = AF_NETLINK;
+        addr.nl_groups = 1;
+        if (bind(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) != 0) {
+            PLOG(ERROR) << "Cannot bind the uevent socket";
+            close(fd);
+            return -1;
+        }
+        mNetlink = true;
+    }
+    mFd = fd;
+
+    if (pthread_create(&thread, nullptr, execLoop, this) != 0) {
+        LOG(ERROR) << "Cannot create the hotplug thread";
+        if (mNetlink) {
+            close(mFd);
+        }
+        mFd = -1;
+        return -1;
+    }
+    pthread_setname_np(thread, "lights-hotplug");
+    pthread_detach(thread);
+
+    return 0;
+}
+
+/**
+ * Read one uevent and handle it
+ * @return 0 if success, -1 once the socket is closed or broken
+ */
+int LightsHotplug::receive()
+{
+    struct sockaddr_nl addr;
+    char control[CMSG_SPACE(sizeof(struct ucred))];
+    struct iovec iov = { mBuf, UEVENT_SIZE };
+    struct msghdr msg;
+
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    if (mNetlink) {
+        msg.msg_name = &addr;
+        msg.msg_namelen = sizeof(addr);
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+    }
+
+    ssize_t n = recvmsg(mFd, &msg, 0);
+    if (n < 0) {
+        if ((errno == EINTR) || (errno == EAGAIN)) {
+            return 0;
+        }
+        if (errno == ENOBUFS) {
+            /* events lost, the next ones are still meaningful */
+            LOG(WARNING) << "Uevent socket overrun";
+            return 0;
+        }
+        PLOG(ERROR) << "Cannot read the uevent socket";
+        return -1;
+    }
+    if (n == 0) {
+        /* injector gone */
+        return -1;
+    }
+
+    if (mNetlink) {
+        struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+        struct ucred* cred = (cmsg != nullptr) && (cmsg->cmsg_type == SCM_CREDENTIALS) ?
+                reinterpret_cast<struct ucred*>(CMSG_DATA(cmsg)) : nullptr;
+        if ((cred == nullptr) || (cred->uid != 0) || (addr.nl_groups == 0) ||
+            (addr.nl_pid != 0)) {
+            /* not broadcast by the kernel */
+            mRejected.fetch_add(1, std::memory_order_relaxed);
+            return 0;
+        }
+    }
+
+    mBuf[n] = '\0';
+    mEvents.fetch_add(1, std::memory_order_relaxed);
+    handle(mBuf, n);
+    return 0;
+}
+
+/**
+ * Handle a uevent: "action@devpath" then "KEY=value" strings, each one
+ * nul terminated
+ * @param buf = uevent
+ * @param size = uevent size
+ */
+void LightsHotplug::handle(const char* buf, size_t size)
+{
+    const char* action = nullptr;
+    const char* devpath = nullptr;
+    const char* subsystem = nullptr;
+
+    for (const char* s = buf; s < buf + size; s += strlen(s) + 1) {
+        if (strncmp(s, "ACTION=", 7) == 0) {
+            action = s + 7;
+        } else if (strncmp(s, "DEVPATH=", 8) == 0) {
+            devpath = s + 8;
+        } else if (strncmp(s, "SUBSYSTEM=", 10) == 0) {
+            subsystem = s + 10;
+        }
+    }
+    if ((action == nullptr) || (devpath == nullptr) || (subsystem == nullptr) ||
+        ((strcmp(subsystem, "leds") != 0) && (strcmp(subsystem, "backlight") != 0))) {
+        return;
+    }
+
+    const char* name = strrchr(devpath, '/');
+    name = (name != nullptr) ? name + 1 : devpath;
+    LightsLed* led = LightsUtils::findLed(name);
+    if (led == nullptr) {
+        LOG(VERBOSE) << "Uevent " << action << " of unmapped device " << name;
+        return;
+    }
+
+    if (strcmp(action, "remove") == 0) {
+        LOG(INFO) << "Device " << name << " removed";
+        removePending(led);
+        led->detach();
+        mRemoved.fetch_add(1, std::memory_order_relaxed);
+        mListener->onLedRemoved(led);
+    } else if (strcmp(action, "add") == 0) {
+        LOG(INFO) << "Device " << name << " added";
+        addPending(led, LightsScheduler::getTimestampMonotonic());
+    }
+}
+
+/**
+ * Queue a device probe, immediately due
+ * @param led = device added
+ * @param now = current monotonic time in nanoseconds
+ */
+void LightsHotplug::addPending(LightsLed* led, int64_t now)
+{
+    removePending(led);
+    if (mNbPending >= MAX_PENDING) {
+        LOG(ERROR) << "Too many devices added, " << led->getName() << " ignored";
+        mFailures.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    mPending[mNbPending++] = { led, 0, now };
+}
+
+void LightsHotplug::removePending(LightsLed* led)
+{
+    for (int i = 0; i < mNbPending; i++) {
+        if (mPending[i].led == led) {
+            mPending[i] = mPending[--mNbPending];
+            return;
+        }
+    }
+}
+
+/**
+ * Probe the devices whose retry is due, the delay doubles on each failure
+ * @param now = current monotonic time in nanoseconds
+ * @return next retry deadline, -1 if none
+ */
+int64_t LightsHotplug::runPending(int64_t now)
+{
+    int64_t next = -1;
+
+    for (int i = 0; i < mNbPending; ) {
+        Pending* p = &mPending[i];
+        if (p->deadline > now) {
+            next = ((next < 0) || (p->deadline < next)) ? p->deadline : next;
+            i++;
+            continue;
+        }
+
+        LightsLed* led = p->led;
+        p->attempts++;
+        if (led->attach() == 0) {
+            mPending[i] = mPending[--mNbPending];
+            mAdded.fetch_add(1, std::memory_order_relaxed);
+            mListener->onLedAdded(led);
+            continue;
+        }
+        if (p->attempts >= MAX_RETRIES) {
+            LOG(ERROR) << "Device " << led->getName() << " not usable after "
+                       << p->attempts << " attempts";
+            mPending[i] = mPending[--mNbPending];
+            mFailures.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+        mRetries.fetch_add(1, std::memory_order_relaxed);
+        p->deadline = now + ((int64_t)RETRY_DELAY_MS << (p->attempts - 1)) * ONE_MS_IN_NS;
+        next = ((next < 0) || (p->deadline < next)) ? p->deadline : next;
+        i++;
+    }
+
+    return next;
+}
+
+void LightsHotplug::loop()
+{
+    struct pollfd pfd = { mFd, POLLIN, 0 };
+
+    LOG(INFO) << "Start lights hotplug";
+
+    for (;;) {
+        int64_t now = LightsScheduler::getTimestampMonotonic();
+        int64_t next = runPending(now);
+        int timeout = (next < 0) ? -1 : (int)((next - now + ONE_MS_IN_NS - 1) / ONE_MS_IN_NS);
+
+        int n = poll(&pfd, 1, timeout);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            PLOG(ERROR) << "Lights hotplug poll returned an error";
+            break;
+        }
+        if ((n > 0) && (receive() != 0)) {
+            break;
+        }
+    }
+
+    LOG(INFO) << "Stop lights hotplug";
+}
+
+/**
+ * Print hotplug statistics
+ * @param fd = output file descriptor
+ */
+void LightsHotplug::dump(int fd)
+{
+    dprintf(fd, "Hotplug: source=%s events=%llu rejected=%llu added=%llu removed=%llu "
+            "retries=%llu failures=%llu\n", mNetlink ? "netlink" : "injected",
+            (unsigned long long)mEvents.load(std::memory_order_relaxed),
+            (unsigned long long)mRejected.load(std::memory_order_relaxed),
+            (unsigned long long)mAdded.load(std::memory_order_relaxed),
+            (unsigned long long)mRemoved.load(std::memory_order_relaxed),
+            (unsigned long long)mRetries.load(std::memory_order_relaxed),
+            (unsigned long long)mFailures.load(std::memory_order_relaxed));
+}
+
+}  // namespace light
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
@@ -0,0 +1,108 @@
+/*
+ * Copyright (C) 2024 STMicroelectronics
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "LightsLed.h"
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace light {
+
+/**
+ * Receiver of the device arrivals and departures
+ */
+class LightsHotplugListener {
+    public:
+        virtual ~LightsHotplugListener() {}
+        /**
+         * Called from the hotplug thread once the device nodes are usable again
+         * @param led = device back
+         */
+        virtual void onLedAdded(LightsLed* led) = 0;
+        /**
+         * Called from the hotplug thread when the device is gone
+         * @param led = device removed
+         */
+        virtual void onLedRemoved(LightsLed* led) = 0;
+};
+
+/**
+ * Tracking of the leds and backlights coming and going (expansion boards,
+ * driver unbind/rebind), from the kernel uevents of the "leds" and
+ * "backlight" subsystems.
+ *
+ * Only the devices of the light table are tracked. A removed device is
+ * marked absent, so that calls do not probe it. On arrival, its nodes may
+ * show up after the uevent: the device is probed again with an
+ * exponential backoff, up to MAX_RETRIES times, then the listener applies
+ * the current state again.
+ *
+ * Events are read by a dedicated thread from a NETLINK_KOBJECT_UEVENT
+ * socket, only messages sent by the kernel are accepted. Any datagram
+ * socket carrying uevents can be given instead, to inject events.
+ */
+class LightsHotplug {
+    public:
+        static int const MAX_RETRIES = 6;
+        static int const RETRY_DELAY_MS = 10;
+    private:
+        static int const MAX_PENDING = 16;
+        static size_t const UEVENT_SIZE = 2048;
+
+        /* device waiting for its nodes */
+        struct Pending {
+            LightsLed* led;
+            int attempts;
+            int64_t deadline;
+        };
+
+        LightsHotplugListener* mListener;
+        int mFd = -1;
+        bool mNetlink = false;
+        Pending mPending[MAX_PENDING];
+        int mNbPending = 0;
+        char mBuf[UEVENT_SIZE + 1];
+        std::atomic<uint64_t> mEvents{0};
+        std::atomic<uint64_t> mRejected{0};
+        std::atomic<uint64_t> mAdded{0};
+        std::atomic<uint64_t> mRemoved{0};
+        std::atomic<uint64_t> mRetries{0};
+        std::atomic<uint64_t> mFailures{0};
+
+        int receive();
+        void handle(const char* buf, size_t size);
+        void addPending(LightsLed* led, int64_t now);
+        void removePending(LightsLed* led);
+        int64_t runPending(int64_t now);
+    public:
+        explicit LightsHotplug(LightsHotplugListener* listener) : mListener{listener} {}
+        int start(int fd);
+        void loop();
+        uint64_t getAdded() const { return mAdded.load(std::memory_order_relaxed); }
+        uint64_t getRetries() const { return mRetries.load(std::memory_order_relaxed); }
+        void dump(int fd);
+};
+
+}  // namespace light
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
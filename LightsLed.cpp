@@ -0,0 +1,741 @@
+/*
+ * Copyright (C) 2024 STMicroelectronics
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "LightsLed.h"
+#include "LightsScheduler.h"
+#include "LightsTrace.h"
+
+#include <android-base/logging.h>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace light {
+
+static char const* const LED_TRIGGER_NONE = "none";
+static char const* const LED_TRIGGER_TIMER = "timer";
+static char const* const LED_TRIGGER_PATTERN = "pattern";
+static char const* const LED_TRIGGER_HEARTBEAT = "heartbeat";
+
+LightsLed::LightsLed(int id, const char* name, const char* dir, bool hasTrigger,
+                     long int defaultMaxBrightness, LightsCurve curve)
+    : mId{id}, mHasTrigger{hasTrigger}, mDefaultMaxBrightness{defaultMaxBrightness}, mCurve{curve}
+{
+    LightsScheduler::initMutex(&mMutex);
+    pthread_mutex_init(&mWriteMutex, nullptr);
+    snprintf(mName, sizeof(mName), "%s", name);
+    mShadowTrigger[0] = '\0';
+    mShadowBrightness = -1;
+    snprintf(mDir, sizeof(mDir), "%s", dir);
+    snprintf(mBrightnessPath, sizeof(mBrightnessPath), "%s/brightness", dir);
+    snprintf(mTriggerPath, sizeof(mTriggerPath), "%s/trigger", dir);
+    snprintf(mMaxBrightnessPath, sizeof(mMaxBrightnessPath), "%s/max_brightness", dir);
+    snprintf(mIntensityPath, sizeof(mIntensityPath), "%s/multi_intensity", dir);
+}
+
+LightsLed::~LightsLed()
+{
+    pthread_mutex_lock(&mMutex);
+    invalidateLocked();
+    pthread_mutex_unlock(&mMutex);
+    pthread_mutex_destroy(&mMutex);
+    pthread_mutex_destroy(&mWriteMutex);
+}
+
+/**
+ * Take the lock serializing the light updates targeting this device. The
+ * time spent waiting for it is measured when it is contended.
+ */
+void LightsLed::lockWrite()
+{
+    mWriteLocks.fetch_add(1, std::memory_order_relaxed);
+    if (pthread_mutex_trylock(&mWriteMutex) == 0) {
+        return;
+    }
+
+    int64_t start = LightsScheduler::getTimestampMonotonic();
+    pthread_mutex_lock(&mWriteMutex);
+    mContendedWriteLocks.fetch_add(1, std::memory_order_relaxed);
+    mWriteLockWait.record(LightsScheduler::getTimestampMonotonic() - start);
+}
+
+/**
+ * Open the sysfs nodes and read max brightness if not already done
+ * @return 0 if success, error code otherwise
+ */
+int LightsLed::openLocked()
+{
+    if (!mPresent.load(std::memory_order_relaxed)) {
+        return -1;
+    }
+
+    if (mMaxBrightness < 0) {
+        char buf[16] = {0};
+
+        mMaxBrightness = mDefaultMaxBrightness;
+        int fd = open(mMaxBrightnessPath, O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            PLOG(ERROR) << "Failed to open max brightness " << mMaxBrightnessPath;
+        } else {
+            /* max brightness size fixed to 8 bytes */
+            ssize_t rb = read(fd, buf, 8);
+            close(fd);
+            if (rb < 0) {
+                PLOG(ERROR) << "Failed to read max brightness " << mMaxBrightnessPath;
+            } else {
+                char* endptr;
+                long int ret = strtol(buf, &endptr, 10);
+                if ('\0' != *endptr && '\n' != *endptr) {
+                    LOG(ERROR) << "max brightness: Error in string conversion";
+                } else {
+                    mMaxBrightness = ret;
+                }
+            }
+        }
+        mLut.build(mCurve, mMaxBrightness);
+        if (mHasTrigger) {
+            probeChannelsLocked();
+        }
+    }
+
+    if ((mNbChannels > 0) && (mIntensityFd < 0)) {
+        mIntensityFd = open(mIntensityPath, O_RDWR | O_CLOEXEC);
+        if (mIntensityFd < 0) {
+            PLOG(ERROR) << "Failed to open light intensity " << mIntensityPath;
+        }
+    }
+
+    if (mHasTrigger && !mTriggerMissing && (mTriggerFd < 0)) {
+        mTriggerFd = open(mTriggerPath, O_RDWR | O_CLOEXEC);
+        if (mTriggerFd < 0) {
+            /* not retried on each update, only when the device is attached again */
+            PLOG(ERROR) << "Failed to open light trigger " << mTriggerPath
+                        << ", led driven without trigger";
+            mTriggerMissing = true;
+            mTriggers.store(0, std::memory_order_relaxed);
+        } else {
+            probeTriggersLocked();
+        }
+    }
+
+    if (mBrightnessFd < 0) {
+        mBrightnessFd = open(mBrightnessPath, O_RDWR | O_CLOEXEC);
+        if (mBrightnessFd < 0) {
+            PLOG(ERROR) << "Failed to open light brightness " << mBrightnessPath;
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Read the triggers supported by the led, and the active one
+ */
+void LightsLed::probeTriggersLocked()
+{
+    char buf[4096];
+    char* saveptr;
+    int triggers = 0;
+
+    mTriggers.store(0, std::memory_order_relaxed);
+
+    ssize_t rb = pread(mTriggerFd, buf, sizeof(buf) - 1, 0);
+    if (rb < 0) {
+        PLOG(ERROR) << "Failed to read light trigger " << mTriggerPath;
+        return;
+    }
+    buf[rb] = '\0';
+
+    /* format is "none [timer] pattern ...", active trigger in brackets */
+    for (char* tok = strtok_r(buf, " \n", &saveptr); tok != nullptr;
+            tok = strtok_r(nullptr, " \n", &saveptr)) {
+        bool active = (tok[0] == '[');
+        if (active) {
+            tok++;
+            char* end = strchr(tok, ']');
+            if (end != nullptr) {
+                *end = '\0';
+            }
+            snprintf(mShadowTrigger, sizeof(mShadowTrigger), "%s", tok);
+        }
+        if (strcmp(tok, LED_TRIGGER_TIMER) == 0) {
+            triggers |= TRIGGER_TIMER;
+        } else if (strcmp(tok, LED_TRIGGER_PATTERN) == 0) {
+            triggers |= TRIGGER_PATTERN;
+        } else if (strcmp(tok, LED_TRIGGER_HEARTBEAT) == 0) {
+            triggers |= TRIGGER_HEARTBEAT;
+        }
+    }
+    mTriggers.store(triggers, std::memory_order_relaxed);
+}
+
+/**
+ * Read the channels of a multicolor led, none if the led is not multicolor
+ */
+void LightsLed::probeChannelsLocked()
+{
+    char path[PATH_MAX];
+    char buf[128];
+    char* saveptr;
+
+    mNbChannels = 0;
+
+    snprintf(path, sizeof(path), "%s/multi_index", mDir);
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        /* single color led */
+        return;
+    }
+    ssize_t rb = read(fd, buf, sizeof(buf) - 1);
+    close(fd);
+    if (rb < 0) {
+        PLOG(ERROR) << "Failed to read " << path;
+        return;
+    }
+    buf[rb] = '\0';
+
+    /* format is "red green blue", one name per channel */
+    for (char* tok = strtok_r(buf, " \n", &saveptr); tok != nullptr;
+            tok = strtok_r(nullptr, " \n", &saveptr)) {
+        if (mNbChannels >= MAX_CHANNELS) {
+            LOG(ERROR) << "Too many channels in " << path << ", led driven as single color";
+            mNbChannels = 0;
+            return;
+        }
+        if (strcmp(tok, "red") == 0) {
+            mChannels[mNbChannels++] = CHANNEL_RED;
+        } else if (strcmp(tok, "green") == 0) {
+            mChannels[mNbChannels++] = CHANNEL_GREEN;
+        } else if (strcmp(tok, "blue") == 0) {
+            mChannels[mNbChannels++] = CHANNEL_BLUE;
+        } else {
+            mChannels[mNbChannels++] = CHANNEL_OTHER;
+        }
+    }
+}
+
+/**
+ * Close the cached nodes, they are reopened (and max brightness read again)
+ * on next access. The device state is unknown afterwards.
+ */
+void LightsLed::invalidateLocked()
+{
+    mShadowTrigger[0] = '\0';
+    mShadowBrightness = -1;
+    if (mBrightnessFd >= 0) {
+        close(mBrightnessFd);
+        mBrightnessFd = -1;
+    }
+    if (mTriggerFd >= 0) {
+        close(mTriggerFd);
+        mTriggerFd = -1;
+    }
+    if (mIntensityFd >= 0) {
+        close(mIntensityFd);
+        mIntensityFd = -1;
+    }
+    mShadowColor = -1;
+    mShadowRepeat = INT_MIN;
+    mNbChannels = 0;
+    mMaxBrightness = -1;
+    mTriggers.store(mTriggerMissing ? 0 : -1, std::memory_order_relaxed);
+}
+
+void LightsLed::invalidate()
+{
+    pthread_mutex_lock(&mMutex);
+    invalidateLocked();
+    pthread_mutex_unlock(&mMutex);
+}
+
+/**
+ * Probe a device back after hotplug: the capabilities are read again
+ * @return 0 if the nodes are usable, error code otherwise (still detached)
+ */
+int LightsLed::attach()
+{
+    int ret;
+
+    pthread_mutex_lock(&mMutex);
+    mTriggerMissing = false;
+    invalidateLocked();
+    mPresent.store(true, std::memory_order_release);
+    ret = openLocked();
+    if (ret != 0) {
+        invalidateLocked();
+        mPresent.store(false, std::memory_order_release);
+    }
+    pthread_mutex_unlock(&mMutex);
+
+    return ret;
+}
+
+/**
+ * Mark the device as gone and close its nodes
+ */
+void LightsLed::detach()
+{
+    pthread_mutex_lock(&mMutex);
+    mPresent.store(false, std::memory_order_release);
+    invalidateLocked();
+    pthread_mutex_unlock(&mMutex);
+}
+
+/**
+ * Write a value in a cached sysfs node
+ * @param fd = cached file descriptor
+ * @param path = node path, for trace purpose
+ * @param buf = value to write
+ * @param size = value size
+ * @return 0 if success, error code otherwise
+ */
+int LightsLed::writeLocked(int fd, const char* path, const char* buf, size_t size)
+{
+    int64_t start = LightsScheduler::getTimestampMonotonic();
+    ssize_t wb = pwrite(fd, buf, size, 0);
+    mWriteLatency.record(LightsScheduler::getTimestampMonotonic() - start);
+    mWrites.fetch_add(1, std::memory_order_relaxed);
+    if (wb == -1) {
+        PLOG(ERROR) << "Failed to write " << path;
+        mWriteErrors.fetch_add(1, std::memory_order_relaxed);
+        LightsTrace::record(LightsTraceEvent::LED_WRITE_ERROR, mId, errno);
+        if ((errno == ENODEV) || (errno == EBADF)) {
+            invalidateLocked();
+        } else {
+            /* partial state change is possible, do not trust the shadow */
+            mShadowTrigger[0] = '\0';
+            mShadowBrightness = -1;
+            mShadowColor = -1;
+        }
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Open the nodes and read the device capabilities: max brightness,
+ * multicolor channels and supported triggers
+ * @return 0 if success, error code otherwise
+ */
+int LightsLed::probe()
+{
+    int ret;
+
+    pthread_mutex_lock(&mMutex);
+    ret = openLocked();
+    pthread_mutex_unlock(&mMutex);
+
+    return ret;
+}
+
+/**
+ * Get max brightness (read once)
+ * @return max brightness
+ */
+long int LightsLed::getMaxBrightness()
+{
+    long int max_brightness;
+
+    pthread_mutex_lock(&mMutex);
+    openLocked();
+    max_brightness = mMaxBrightness;
+    pthread_mutex_unlock(&mMutex);
+
+    return max_brightness;
+}
+
+/**
+ * Convert a color to the device brightness
+ * @param color = RGB color value
+ * @return brightness, scaled to max brightness
+ */
+long int LightsLed::getBrightness(int color)
+{
+    long int brightness;
+
+    pthread_mutex_lock(&mMutex);
+    openLocked();
+    if (mNbChannels > 0) {
+        /* the color is in multi_intensity, brightness only switches on and off */
+        brightness = ((color & 0x00FFFFFF) != 0) ? mMaxBrightness : 0;
+    } else {
+        brightness = mLut.getBrightness(color);
+    }
+    pthread_mutex_unlock(&mMutex);
+
+    return brightness;
+}
+
+/**
+ * Convert a color dimmed by a level to the device brightness
+ * @param color = RGB color value
+ * @param level = dimming level, 0..255
+ * @return brightness, scaled to max brightness
+ */
+long int LightsLed::getScaledBrightness(int color, uint32_t level)
+{
+    long int brightness;
+
+    if (level > 255) {
+        level = 255;
+    }
+
+    pthread_mutex_lock(&mMutex);
+    openLocked();
+    if (mNbChannels > 0) {
+        /* the color is in multi_intensity, the level on the brightness */
+        brightness = ((color & 0x00FFFFFF) != 0) ? (mMaxBrightness * level + 127) / 255 : 0;
+    } else {
+        brightness = mLut.getLevelBrightness((LightsColorLut::getLuma(color) * level + 127) / 255);
+    }
+    pthread_mutex_unlock(&mMutex);
+
+    return brightness;
+}
+
+/**
+ * Set the brightness value
+ * @param brightness = raw brightness, already scaled to max brightness
+ * @return 0 if success, error code otherwise
+ */
+int LightsLed::setBrightness(long int brightness)
+{
+    char buf[24];
+    int ret;
+
+    pthread_mutex_lock(&mMutex);
+    ret = openLocked();
+    if (ret == 0) {
+        bool noTrigger = !mHasTrigger || mTriggerMissing ||
+                         (strcmp(mShadowTrigger, LED_TRIGGER_NONE) == 0);
+        if (noTrigger && (brightness == mShadowBrightness)) {
+            mSuppressedWrites.fetch_add(1, std::memory_order_relaxed);
+        } else {
+            int size_w = snprintf(buf, sizeof(buf), "%ld", brightness);
+            ret = writeLocked(mBrightnessFd, mBrightnessPath, buf, size_w);
+            if (ret == 0) {
+                mShadowBrightness = brightness;
+                /* kernel removes the active trigger when brightness is set to 0 */
+                if (mHasTrigger && (brightness == 0)) {
+                    strcpy(mShadowTrigger, LED_TRIGGER_NONE);
+                }
+            }
+        }
+    }
+    pthread_mutex_unlock(&mMutex);
+
+    return ret;
+}
+
+/**
+ * Set the channel intensities of a multicolor led, in a single write.
+ * No-op for a single color led, and for black: the led is switched off
+ * by the brightness and keeps its intensities, so that blinking a color
+ * only writes the brightness.
+ * @param color = RGB color value
+ * @return 0 if success, error code otherwise
+ */
+int LightsLed::setColor(int color)
+{
+    char buf[MAX_CHANNELS * 12];
+    int size_w = 0;
+    int ret;
+
+    color = color & 0x00FFFFFF;
+
+    pthread_mutex_lock(&mMutex);
+    ret = openLocked();
+    if ((ret == 0) && (mNbChannels > 0) && (color != 0)) {
+        if (mIntensityFd < 0) {
+            ret = -1;
+        } else if (color == mShadowColor) {
+            mSuppressedWrites.fetch_add(1, std::memory_order_relaxed);
+        } else {
+            for (int i = 0; i < mNbChannels; i++) {
+                uint32_t level;
+                switch (mChannels[i]) {
+                    case CHANNEL_RED:
+                        level = (color >> 16) & 0xff;
+                        break;
+                    case CHANNEL_GREEN:
+                        level = (color >> 8) & 0xff;
+                        break;
+                    case CHANNEL_BLUE:
+                        level = color & 0xff;
+                        break;
+                    default:
+                        level = LightsColorLut::getLuma(color);
+                        break;
+                }
+                size_w += snprintf(buf + size_w, sizeof(buf) - size_w, (i == 0) ? "%ld" : " %ld",
+                                   mLut.getLevelBrightness(level));
+            }
+            ret = writeLocked(mIntensityFd, mIntensityPath, buf, size_w);
+            if (ret == 0) {
+                mShadowColor = color;
+            }
+        }
+    }
+    pthread_mutex_unlock(&mMutex);
+
+    return ret;
+}
+
+/**
+ * Set the led trigger, unless already active
+ * @param trigger = trigger name
+ * @return 0 if success, error code otherwise
+ */
+int LightsLed::setTriggerLocked(const char* trigger)
+{
+    int ret = -1;
+
+    if (mTriggerFd >= 0) {
+        if (strcmp(mShadowTrigger, trigger) == 0) {
+            mSuppressedWrites.fetch_add(1, std::memory_order_relaxed);
+            ret = 0;
+        } else {
+            ret = writeLocked(mTriggerFd, mTriggerPath, trigger, strlen(trigger));
+            if (ret == 0) {
+                snprintf(mShadowTrigger, sizeof(mShadowTrigger), "%s", trigger);
+                /* trigger data is reset, pattern repeats forever by default */
+                mShadowRepeat = -1;
+                /* kernel turns the led off when changing trigger */
+                mShadowBrightness = -1;
+            }
+        }
+    }
+
+    return ret;
+}
+
+/**
+ * Set the led trigger
+ * @param trigger = trigger name
+ * @return 0 if success, error code otherwise
+ */
+int LightsLed::setTrigger(const char* trigger)
+{
+    int ret;
+
+    pthread_mutex_lock(&mMutex);
+    openLocked();
+    ret = setTriggerLocked(trigger);
+    pthread_mutex_unlock(&mMutex);
+
+    return ret;
+}
+
+/**
+ * Check if a trigger is supported by the led
+ * @param trigger
+ * @return true if supported, false otherwise
+ */
+bool LightsLed::supportsTrigger(Trigger trigger)
+{
+    int triggers = mTriggers.load(std::memory_order_relaxed);
+
+    if (triggers < 0) {
+        /* not probed yet, or invalidated */
+        pthread_mutex_lock(&mMutex);
+        openLocked();
+        triggers = mTriggers.load(std::memory_order_relaxed);
+        pthread_mutex_unlock(&mMutex);
+    }
+
+    return (triggers > 0) && ((triggers & trigger) != 0);
+}
+
+/**
+ * Write a trigger attribute. Those nodes only exist while their trigger
+ * is active, so they are not cached.
+ * @param attr = attribute name
+ * @param buf = value to write
+ * @param size = value size
+ * @return 0 if success, error code otherwise
+ */
+int LightsLed::writeAttrLocked(const char* attr, const char* buf, size_t size)
+{
+    char path[PATH_MAX];
+    int ret;
+
+    snprintf(path, sizeof(path), "%s/%s", mDir, attr);
+    int fd = open(path, O_WRONLY | O_CLOEXEC);
+    if (fd < 0) {
+        PLOG(ERROR) << "Failed to open " << path;
+        return -1;
+    }
+    ret = writeLocked(fd, path, buf, size);
+    close(fd);
+
+    return ret;
+}
+
+/**
+ * Blink the led with the kernel "timer" trigger
+ * @param brightness = raw brightness of the on phase
+ * @param onMs = on phase duration
+ * @param offMs = off phase duration
+ * @return 0 if success, error code otherwise
+ */
+int LightsLed::setTimerBlink(long int brightness, int onMs, int offMs)
+{
+    char buf[24];
+    int size_w;
+    int ret;
+
+    pthread_mutex_lock(&mMutex);
+    ret = openLocked();
+    if (ret == 0) {
+        /* if already active, writing the delays restarts the blink */
+        ret = setTriggerLocked(LED_TRIGGER_TIMER);
+    }
+    if (ret == 0) {
+        size_w = snprintf(buf, sizeof(buf), "%d", onMs);
+        ret = writeAttrLocked("delay_on", buf, size_w);
+    }
+    if (ret == 0) {
+        size_w = snprintf(buf, sizeof(buf), "%d", offMs);
+        ret = writeAttrLocked("delay_off", buf, size_w);
+    }
+    if (ret == 0) {
+        /* a non zero brightness sets the blink brightness */
+        size_w = snprintf(buf, sizeof(buf), "%ld", brightness);
+        ret = writeLocked(mBrightnessFd, mBrightnessPath, buf, size_w);
+    }
+    pthread_mutex_unlock(&mMutex);
+
+    return ret;
+}
+
+/**
+ * Blink the led with the kernel "pattern" trigger
+ * @param brightness = raw brightness of the on phase
+ * @param onMs = on phase duration
+ * @param offMs = off phase duration
+ * @return 0 if success, error code otherwise
+ */
+int LightsLed::setPatternBlink(long int brightness, int onMs, int offMs)
+{
+    char buf[96];
+    int size_w;
+    int ret;
+
+    pthread_mutex_lock(&mMutex);
+    ret = openLocked();
+    if (ret == 0) {
+        ret = setTriggerLocked(LED_TRIGGER_PATTERN);
+    }
+    if (ret == 0) {
+        /* zero duration steps between phases give a square wave */
+        size_w = snprintf(buf, sizeof(buf), "%ld %d %ld 0 0 %d 0 0",
+                          brightness, onMs, brightness, offMs);
+        ret = setPatternLocked(buf, size_w, -1);
+    }
+    pthread_mutex_unlock(&mMutex);
+
+    return ret;
+}
+
+/**
+ * Write the repeat count, if changed, then the pattern of the active
+ * "pattern" trigger. Writing the pattern restarts it.
+ * @param pattern = "brightness duration ..." pairs
+ * @param size = pattern size
+ * @param repeat = number of plays, -1 forever
+ * @return 0 if success, error code otherwise
+ */
+int LightsLed::setPatternLocked(const char* pattern, size_t size, int repeat)
+{
+    char buf[16];
+    int ret = 0;
+
+    if (repeat != mShadowRepeat) {
+        int size_w = snprintf(buf, sizeof(buf), "%d", repeat);
+        ret = writeAttrLocked("repeat", buf, size_w);
+        if (ret == 0) {
+            mShadowRepeat = repeat;
+        }
+    }
+    if (ret == 0) {
+        ret = writeAttrLocked("pattern", pattern, size);
+    }
+    return ret;
+}
+
+/**
+ * Play a pattern with the kernel "pattern" trigger
+ * @param pattern = "brightness duration ..." pairs, raw brightness
+ * @param size = pattern size
+ * @param repeat = number of plays, -1 forever
+ * @return 0 if success, error code otherwise
+ */
+int LightsLed::setPattern(const char* pattern, size_t size, int repeat)
+{
+    int ret;
+
+    pthread_mutex_lock(&mMutex);
+    ret = openLocked();
+    if (ret == 0) {
+        ret = setTriggerLocked(LED_TRIGGER_PATTERN);
+    }
+    if (ret == 0) {
+        ret = setPatternLocked(pattern, size, repeat);
+    }
+    pthread_mutex_unlock(&mMutex);
+
+    return ret;
+}
+
+/**
+ * Print sysfs write statistics
+ * @param fd = output file descriptor
+ */
+void LightsLed::dump(int fd)
+{
+    /* rewritten on probe and hotplug: copied under the mutex, printed without it */
+    pthread_mutex_lock(&mMutex);
+    long int maxBrightness = mMaxBrightness;
+    int nbChannels = mNbChannels;
+    pthread_mutex_unlock(&mMutex);
+
+    dprintf(fd, "  %s: %smax_brightness=%ld channels=%d curve=%s writes=%llu suppressed=%llu errors=%llu\n",
+            mDir, isPresent() ? "" : "absent ", maxBrightness, (nbChannels > 0) ? nbChannels : 1,
+            LightsColorLut::getCurveName(mCurve),
+            (unsigned long long)mWrites.load(std::memory_order_relaxed),
+            (unsigned long long)mSuppressedWrites.load(std::memory_order_relaxed),
+            (unsigned long long)mWriteErrors.load(std::memory_order_relaxed));
+    mWriteLatency.dump(fd, "write latency");
+    dprintf(fd, "    write lock: acquired=%llu contended=%llu\n",
+            (unsigned long long)mWriteLocks.load(std::memory_order_relaxed),
+            (unsigned long long)mContendedWriteLocks.load(std::memory_order_relaxed));
+    mWriteLockWait.dump(fd, "write lock wait");
+}
+
+}  // namespace light
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
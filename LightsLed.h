@@ -0,0 +1,148 @@
+/*
+ * Copyright (C) 2024 STMicroelectronics
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "LightsColor.h"
+#include "LightsStats.h"
+
+#include <atomic>
+#include <limits.h>
+#include <pthread.h>
+#include <stdint.h>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace light {
+
+/**
+ * Handle on one physical LED (or backlight) sysfs directory.
+ *
+ * The brightness and trigger nodes are opened once and kept open, and
+ * max_brightness is read once, so that an update is a single pwrite().
+ * When a write fails because the device went away (ENODEV/EBADF), the
+ * handle closes its nodes and reopens them on next use.
+ *
+ * The last trigger and brightness written are shadowed so that writing
+ * the same value again does not reach sysfs. The brightness shadow is only
+ * trusted while no trigger is active, as triggers drive the brightness.
+ *
+ * Colors are converted with a lookup table built when max_brightness is
+ * read, see LightsColorLut.
+ *
+ * Leds of the multicolor class (multi_index/multi_intensity nodes) get
+ * the color of each channel in a single multi_intensity write, the
+ * brightness node then only switches the led on and off.
+ *
+ * The triggers listed by the kernel are probed on first open, so that
+ * blinking can be offloaded to the "timer" or "pattern" trigger. The
+ * service probes every led once at startup (probe()), the supported
+ * triggers are then read without taking the led mutex.
+ *
+ * A device unplugged is detached: its nodes are closed and accesses fail
+ * without touching sysfs, until it is attached again (see LightsHotplug).
+ */
+class alignas(LIGHTS_CACHE_LINE_SIZE) LightsLed {
+    public:
+        enum Trigger {
+            TRIGGER_TIMER = 1 << 0,
+            TRIGGER_PATTERN = 1 << 1,
+            TRIGGER_HEARTBEAT = 1 << 2,
+        };
+        static int const MAX_CHANNELS = 4;
+    private:
+        /* multicolor channel, taken from multi_index */
+        enum Channel {
+            CHANNEL_RED,
+            CHANNEL_GREEN,
+            CHANNEL_BLUE,
+            CHANNEL_OTHER, // white, amber...: driven by the luminance
+        };
+
+        pthread_mutex_t mMutex;
+        pthread_mutex_t mWriteMutex;
+        int mId;
+        char mName[NAME_MAX + 1];
+        char mBrightnessPath[PATH_MAX];
+        char mTriggerPath[PATH_MAX];
+        char mMaxBrightnessPath[PATH_MAX];
+        char mIntensityPath[PATH_MAX];
+        char mDir[PATH_MAX];
+        bool mHasTrigger;
+        /* trigger node absent (kernel without led triggers), until probed again */
+        bool mTriggerMissing = false;
+        std::atomic<bool> mPresent{true};
+        int mBrightnessFd = -1;
+        int mTriggerFd = -1;
+        int mIntensityFd = -1;
+        Channel mChannels[MAX_CHANNELS];
+        int mNbChannels = 0;
+        int mShadowColor = -1;
+        long int mMaxBrightness = -1;
+        long int mDefaultMaxBrightness;
+        LightsCurve mCurve;
+        LightsColorLut mLut;
+        char mShadowTrigger[32];
+        long int mShadowBrightness;
+        int mShadowRepeat = INT_MIN;
+        std::atomic<int> mTriggers{-1};
+        std::atomic<uint64_t> mWrites{0};
+        std::atomic<uint64_t> mSuppressedWrites{0};
+        std::atomic<uint64_t> mWriteErrors{0};
+        LightsHistogram mWriteLatency;
+        std::atomic<uint64_t> mWriteLocks{0};
+        std::atomic<uint64_t> mContendedWriteLocks{0};
+        LightsHistogram mWriteLockWait;
+
+        int openLocked();
+        void probeTriggersLocked();
+        void probeChannelsLocked();
+        void invalidateLocked();
+        int writeLocked(int fd, const char* path, const char* buf, size_t size);
+        int setTriggerLocked(const char* trigger);
+        int writeAttrLocked(const char* attr, const char* buf, size_t size);
+        int setPatternLocked(const char* pattern, size_t size, int repeat);
+    public:
+        LightsLed(int id, const char* name, const char* dir, bool hasTrigger,
+                  long int defaultMaxBrightness, LightsCurve curve);
+        ~LightsLed();
+        int getId() const { return mId; }
+        const char* getName() const { return mName; }
+        void lockWrite();
+        void unlockWrite() { pthread_mutex_unlock(&mWriteMutex); }
+        int probe();
+        long int getMaxBrightness();
+        long int getBrightness(int color);
+        long int getScaledBrightness(int color, uint32_t level);
+        int setBrightness(long int brightness);
+        int setColor(int color);
+        int setTrigger(const char* trigger);
+        bool supportsTrigger(Trigger trigger);
+        int setTimerBlink(long int brightness, int onMs, int offMs);
+        int setPatternBlink(long int brightness, int onMs, int offMs);
+        int setPattern(const char* pattern, size_t size, int repeat);
+        void invalidate();
+        bool isPresent() const { return mPresent.load(std::memory_order_acquire); }
+        int attach();
+        void detach();
+        void dump(int fd);
+};
+
+}  // namespace light
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
@@ -0,0 +1,360 @@
+/*
+ * Copyright (C) 2024 STMicroelectronics
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "LightsPattern.h"
+#include "LightsTrace.h"
+
+#include <android-base/logging.h>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace light {
+
+static int64_t const ONE_MS_IN_NS = 1000000LL;
+static int64_t const ONE_S_IN_NS = 1000000000LL;
+
+/* a step is "<brightness> <duration> <brightness> 0" at most */
+static size_t const PATTERN_STEP_MAX_SIZE = 48;
+
+LightsPattern::LightsPattern(HwLight light, LightsLed* led, int rateHz)
+    : mHwLight{light}, mLed{led}
+{
+    mPeriod = ONE_S_IN_NS / ((rateHz > 0) ? rateHz : 1);
+    LightsScheduler::initMutex(&mPatternMutex);
+}
+
+LightsPattern::~LightsPattern()
+{
+    stop();
+    pthread_mutex_destroy(&mPatternMutex);
+}
+
+/**
+ * Parse a pattern: steps "<level>:<duration ms>[:r]" separated by commas
+ * or spaces, ":r" ramping to the level of the next step
+ * @param spec = pattern description
+ * @param frames = keyframes to fill
+ * @param maxFrames = size of frames
+ * @return number of keyframes, -1 if invalid
+ */
+int LightsPattern::parse(const char* spec, LightsKeyframe* frames, int maxFrames)
+{
+    int nbFrames = 0;
+    const char* p = spec;
+
+    while (*p != '\0') {
+        char* end;
+
+        while ((*p == ',') || (*p == ' ')) {
+            p++;
+        }
+        if (*p == '\0') {
+            break;
+        }
+        if (nbFrames >= maxFrames) {
+            LOG(ERROR) << "Too many pattern steps in " << spec;
+            return -1;
+        }
+
+        LightsKeyframe* frame = &frames[nbFrames];
+        long level = strtol(p, &end, 10);
+        if ((end == p) || (*end != ':') || (level < 0) || (level > 255)) {
+            LOG(ERROR) << "Invalid pattern step level in " << spec;
+            return -1;
+        }
+        p = end + 1;
+        long durationMs = strtol(p, &end, 10);
+        if ((end == p) || (durationMs < 0) || (durationMs > INT32_MAX)) {
+            LOG(ERROR) << "Invalid pattern step duration in " << spec;
+            return -1;
+        }
+        p = end;
+        frame->level = level;
+        frame->durationMs = durationMs;
+        frame->ramp = false;
+        if ((p[0] == ':') && (p[1] == 'r')) {
+            frame->ramp = true;
+            p += 2;
+        }
+        if ((*p != '\0') && (*p != ',') && (*p != ' ')) {
+            LOG(ERROR) << "Invalid pattern step in " << spec;
+            return -1;
+        }
+        nbFrames++;
+    }
+
+    return nbFrames;
+}
+
+/**
+ * Set the pattern played by startPreset (HARDWARE flash mode)
+ * @param frames = keyframes
+ * @param nbFrames = number of keyframes
+ */
+void LightsPattern::setPreset(const LightsKeyframe* frames, int nbFrames)
+{
+    pthread_mutex_lock(&mPatternMutex);
+    mNbPresetFrames = 0;
+    if ((nbFrames > 0) && (nbFrames <= MAX_KEYFRAMES)) {
+        memcpy(mPreset, frames, nbFrames * sizeof(*frames));
+        mNbPresetFrames = nbFrames;
+    }
+    pthread_mutex_unlock(&mPatternMutex);
+}
+
+/**
+ * Compile the keyframes to a kernel "pattern" trigger pattern
+ * @param buf = output
+ * @param size = output size
+ * @return pattern size, -1 if too large
+ */
+int LightsPattern::compileLocked(char* buf, size_t size)
+{
+    size_t size_w = 0;
+
+    for (int i = 0; i < mNbFrames; i++) {
+        if (size - size_w < PATTERN_STEP_MAX_SIZE) {
+            return -1;
+        }
+        /*
+         * the kernel moves gradually to the next brightness over a step, a
+         * zero duration step of the same brightness holds it instead
+         */
+        if (mFrames[i].ramp) {
+            size_w += snprintf(buf + size_w, size - size_w, "%s%ld %u", (i == 0) ? "" : " ",
+                               mBrightness[i], mFrames[i].durationMs);
+        } else {
+            size_w += snprintf(buf + size_w, size - size_w, "%s%ld %u %ld 0", (i == 0) ? "" : " ",
+                               mBrightness[i], mFrames[i].durationMs, mBrightness[i]);
+        }
+    }
+    return size_w;
+}
+
+/**
+ * Play a pattern, in the kernel if possible. A pattern already playing
+ * is replaced.
+ * @param color = RGB color value, dimmed by the keyframe levels
+ * @param frames = keyframes
+ * @param nbFrames = number of keyframes
+ * @param repeat = number of plays, 0 forever
+ * @return backend used, LightsBackend::NONE if the pattern is invalid
+ */
+LightsBackend LightsPattern::start(int color, const LightsKeyframe* frames, int nbFrames,
+                                   int repeat)
+{
+    char buf[MAX_KEYFRAMES * PATTERN_STEP_MAX_SIZE];
+    int64_t totalMs = 0;
+    LightsBackend backend = LightsBackend::NONE;
+
+    if ((nbFrames <= 0) || (nbFrames > MAX_KEYFRAMES) || (repeat < 0)) {
+        return LightsBackend::NONE;
+    }
+    for (int i = 0; i < nbFrames; i++) {
+        totalMs += frames[i].durationMs;
+    }
+    if (totalMs == 0) {
+        return LightsBackend::NONE;
+    }
+
+    pthread_mutex_lock(&mPatternMutex);
+    if (mActive) {
+        mActive = false;
+        LightsScheduler::getInstance()->cancel(this);
+    }
+
+    if (frames != mFrames) {
+        memcpy(mFrames, frames, nbFrames * sizeof(*frames));
+    }
+    mNbFrames = nbFrames;
+    mRepeat = repeat;
+    for (int i = 0; i < mNbFrames; i++) {
+        mBrightness[i] = mLed->getScaledBrightness(color, mFrames[i].level);
+    }
+
+    if (mLed->setColor(color) != 0) {
+        goto mutex_unlock;
+    }
+
+    if (LightsUtils::isKernelBlinkEnabled() &&
+        mLed->supportsTrigger(LightsLed::TRIGGER_PATTERN)) {
+        int size = compileLocked(buf, sizeof(buf));
+        if ((size > 0) && (mLed->setPattern(buf, size, (repeat == 0) ? -1 : repeat) == 0)) {
+            mKernelPlays.fetch_add(1, std::memory_order_relaxed);
+            backend = LightsBackend::KERNEL_PATTERN;
+            goto mutex_unlock;
+        }
+    }
+
+    mLed->setTrigger("none");
+    mFrame = 0;
+    mPlays = 0;
+    mFrameStart = LightsScheduler::getTimestampMonotonic();
+    mActive = true;
+    if (LightsScheduler::getInstance()->schedule(this, mFrameStart) != 0) {
+        mActive = false;
+        goto mutex_unlock;
+    }
+    mUserspacePlays.fetch_add(1, std::memory_order_relaxed);
+    backend = LightsBackend::USERSPACE;
+
+mutex_unlock:
+    pthread_mutex_unlock(&mPatternMutex);
+    LightsTrace::record(LightsTraceEvent::PATTERN_START, mHwLight.id,
+                        static_cast<uint32_t>(backend));
+    return backend;
+}
+
+/**
+ * Play the preset pattern forever
+ * @param color = RGB color value, dimmed by the keyframe levels
+ * @return backend used, LightsBackend::NONE without preset
+ */
+LightsBackend LightsPattern::startPreset(int color)
+{
+    if (mNbPresetFrames == 0) {
+        return LightsBackend::NONE;
+    }
+    return start(color, mPreset, mNbPresetFrames, 0);
+}
+
+/**
+ * Stop the pattern played from userspace. Once returned, no more step is
+ * written. A kernel pattern is stopped by the next trigger change.
+ */
+void LightsPattern::stop()
+{
+    pthread_mutex_lock(&mPatternMutex);
+    if (mActive) {
+        mActive = false;
+        LightsScheduler::getInstance()->cancel(this);
+        LightsTrace::record(LightsTraceEvent::PATTERN_STOP, mHwLight.id, 0);
+    }
+    pthread_mutex_unlock(&mPatternMutex);
+}
+
+/**
+ * Write the level of the pattern at a given time
+ * @param now = current monotonic time in nanoseconds
+ * @return next step deadline, -1 once the pattern is over
+ */
+int64_t LightsPattern::stepLocked(int64_t now)
+{
+    int64_t cycle = 0;
+    for (int i = 0; i < mNbFrames; i++) {
+        cycle += mFrames[i].durationMs * ONE_MS_IN_NS;
+    }
+
+    /* whole cycles missed while the thread was late */
+    if ((mFrame == 0) && (now - mFrameStart >= cycle)) {
+        int64_t cycles = (now - mFrameStart) / cycle;
+        mPlays += cycles;
+        mFrameStart += cycles * cycle;
+    }
+
+    for (;;) {
+        int64_t duration = mFrames[mFrame].durationMs * ONE_MS_IN_NS;
+        if ((now - mFrameStart < duration) && ((mRepeat == 0) || (mPlays < mRepeat))) {
+            break;
+        }
+        if ((mRepeat != 0) && (mPlays >= mRepeat)) {
+            /* over: hold the level reached at the end of the last step */
+            int last = mNbFrames - 1;
+            mLed->setBrightness(mFrames[last].ramp ? mBrightness[0] : mBrightness[last]);
+            mActive = false;
+            return -1;
+        }
+        mFrameStart += duration;
+        if (++mFrame == mNbFrames) {
+            mFrame = 0;
+            mPlays++;
+        }
+    }
+
+    int64_t duration = mFrames[mFrame].durationMs * ONE_MS_IN_NS;
+    int64_t frameEnd = mFrameStart + duration;
+    long int brightness = mBrightness[mFrame];
+    int64_t next = frameEnd;
+
+    if (mFrames[mFrame].ramp) {
+        long int to = mBrightness[(mFrame + 1) % mNbFrames];
+        int64_t elapsed = now - mFrameStart;
+        brightness += ((to - brightness) * elapsed + ((to >= brightness) ? 1 : -1) * duration / 2)
+                      / duration;
+        if (now + mPeriod < frameEnd) {
+            next = now + mPeriod;
+        }
+    }
+
+    mSteps.fetch_add(1, std::memory_order_relaxed);
+    if (mLed->setBrightness(brightness) != 0) {
+        LOG(ERROR) << "Cannot set pattern level on " << mLed->getName();
+    }
+    return next;
+}
+
+/**
+ * Write one pattern step
+ * @param now = current monotonic time in nanoseconds
+ * @return next step deadline, -1 once the pattern is over
+ */
+int64_t LightsPattern::onDeadline(int64_t now)
+{
+    int64_t next = -1;
+
+    pthread_mutex_lock(&mPatternMutex);
+    if (mActive) {
+        next = stepLocked(now);
+    }
+    pthread_mutex_unlock(&mPatternMutex);
+
+    return next;
+}
+
+/**
+ * Stop, the scheduler could not queue the next step
+ */
+void LightsPattern::onUnscheduled()
+{
+    pthread_mutex_lock(&mPatternMutex);
+    mActive = false;
+    pthread_mutex_unlock(&mPatternMutex);
+}
+
+/**
+ * Print pattern statistics
+ * @param fd = output file descriptor
+ */
+void LightsPattern::dump(int fd)
+{
+    dprintf(fd, "    pattern: preset steps=%d kernel plays=%llu userspace plays=%llu steps=%llu\n",
+            mNbPresetFrames,
+            (unsigned long long)mKernelPlays.load(std::memory_order_relaxed),
+            (unsigned long long)mUserspacePlays.load(std::memory_order_relaxed),
+            (unsigned long long)mSteps.load(std::memory_order_relaxed));
+}
+
+}  // namespace light
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2024 STMicroelectronics
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "LightsLed.h"
+#include "LightsScheduler.h"
+#include "LightsUtils.h"
+
+#include <atomic>
+#include <pthread.h>
+#include <stdint.h>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace light {
+
+/**
+ * One step of a pattern
+ */
+struct LightsKeyframe {
+    uint32_t level;      // 0..255, scales the light color
+    uint32_t durationMs; // step duration
+    bool ramp;           // move linearly to the level of the next step
+};
+
+/**
+ * Keyframe animation of one light.
+ *
+ * The keyframes are converted once to device brightness levels. When the
+ * led lists the kernel "pattern" trigger, the whole table is compiled to
+ * a single pattern write and played by the kernel; otherwise it is
+ * played from the LightsScheduler thread, ramps being updated at most
+ * once per update period.
+ */
+class alignas(LIGHTS_CACHE_LINE_SIZE) LightsPattern : public LightsSchedulerTask {
+    public:
+        static int const MAX_KEYFRAMES = 32;
+    private:
+        pthread_mutex_t mPatternMutex;
+        HwLight mHwLight;
+        LightsLed* mLed;
+        int64_t mPeriod;
+        LightsKeyframe mFrames[MAX_KEYFRAMES];
+        long int mBrightness[MAX_KEYFRAMES];
+        int mNbFrames = 0;
+        int mRepeat = 0;
+        bool mActive = false;
+        int mFrame = 0;
+        int mPlays = 0;
+        int64_t mFrameStart = 0;
+        LightsKeyframe mPreset[MAX_KEYFRAMES];
+        int mNbPresetFrames = 0;
+        std::atomic<uint64_t> mKernelPlays{0};
+        std::atomic<uint64_t> mUserspacePlays{0};
+        std::atomic<uint64_t> mSteps{0};
+
+        int compileLocked(char* buf, size_t size);
+        int64_t stepLocked(int64_t now);
+    public:
+        LightsPattern(HwLight light, LightsLed* led, int rateHz);
+        ~LightsPattern();
+        static int parse(const char* spec, LightsKeyframe* frames, int maxFrames);
+        void setPreset(const LightsKeyframe* frames, int nbFrames);
+        bool hasPreset() const { return mNbPresetFrames > 0; }
+        LightsBackend start(int color, const LightsKeyframe* frames, int nbFrames, int repeat);
+        LightsBackend startPreset(int color);
+        void stop();
+        int64_t onDeadline(int64_t now) override;
+        void onUnscheduled() override;
+        void dump(int fd);
+};
+
+}  // namespace light
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
@@ -0,0 +1,226 @@
+/*
+ * Copyright (C) 2024 STMicroelectronics
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "LightsRamp.h"
+
+#include <android-base/logging.h>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace light {
+
+static int64_t const ONE_MS_IN_NS = 1000000LL;
+static int64_t const ONE_S_IN_NS = 1000000000LL;
+
+LightsRamp::LightsRamp(LightsLed* led, int rateHz) : mLed{led}
+{
+    mPeriod = ONE_S_IN_NS / ((rateHz > 0) ? rateHz : 1);
+    LightsScheduler::initMutex(&mRampMutex);
+}
+
+LightsRamp::~LightsRamp()
+{
+    stop();
+    pthread_mutex_destroy(&mRampMutex);
+}
+
+/**
+ * Get the interpolated level at a given time
+ * @param time = monotonic time in nanoseconds
+ * @return level, rounded to the nearest hardware level
+ */
+long int LightsRamp::getLevelLocked(int64_t time)
+{
+    int64_t elapsed = time - mStartTime;
+
+    if (elapsed >= mDuration) {
+        return mTo;
+    }
+    if (elapsed <= 0) {
+        return mFrom;
+    }
+
+    int64_t delta = (int64_t)(mTo - mFrom);
+    int64_t steps = llabs(delta);
+    int64_t done = (2 * steps * elapsed + mDuration) / (2 * mDuration);
+    return mFrom + ((delta < 0) ? -done : done);
+}
+
+/**
+ * Get the time of the next step: when the interpolation reaches the next
+ * level, but not before one update period
+ * @param level = level just reached
+ * @param now = current monotonic time in nanoseconds
+ * @return next step deadline, -1 if the transition is over
+ */
+int64_t LightsRamp::getNextStepLocked(long int level, int64_t now)
+{
+    int64_t end = mStartTime + mDuration;
+    int64_t steps = llabs((int64_t)(mTo - mFrom));
+    int64_t done = llabs((int64_t)(level - mFrom));
+
+    if ((level == mTo) || (now >= end)) {
+        return -1;
+    }
+
+    /* level done + 1 is reached half way between the two levels */
+    int64_t change = mStartTime + ((2 * done + 1) * mDuration + 2 * steps - 1) / (2 * steps);
+    int64_t next = now + mPeriod;
+    if (change > next) {
+        next = change;
+    }
+    return (next < end) ? next : end;
+}
+
+int LightsRamp::writeLocked(long int level)
+{
+    if (level == mLevel) {
+        return 0;
+    }
+    mSteps.fetch_add(1, std::memory_order_relaxed);
+    if (mLed->setBrightness(level) != 0) {
+        mLevel = -1;
+        return -1;
+    }
+    mLevel = level;
+    return 0;
+}
+
+/**
+ * Start a transition to a target level, or retarget the one in progress
+ * @param target = target brightness, already scaled to max brightness
+ * @param durationMs = transition duration, 0 to set the target at once
+ * @return 0 if success, error code otherwise
+ */
+int LightsRamp::rampTo(long int target, int durationMs)
+{
+    int ret = 0;
+    int64_t now = LightsScheduler::getTimestampMonotonic();
+
+    pthread_mutex_lock(&mRampMutex);
+    long int current = mActive ? getLevelLocked(now) : mLevel;
+
+    /* unknown start level (first use, after a flash...): no transition */
+    if ((durationMs <= 0) || (current < 0) || (current == target)) {
+        if (mActive) {
+            mActive = false;
+            LightsScheduler::getInstance()->cancel(this);
+        }
+        ret = writeLocked(target);
+        pthread_mutex_unlock(&mRampMutex);
+        return ret;
+    }
+
+    if (mActive) {
+        mRetargets.fetch_add(1, std::memory_order_relaxed);
+    } else {
+        mRamps.fetch_add(1, std::memory_order_relaxed);
+    }
+    mFrom = current;
+    mTo = target;
+    mStartTime = now;
+    mDuration = durationMs * ONE_MS_IN_NS;
+    mActive = true;
+
+    ret = LightsScheduler::getInstance()->schedule(this, getNextStepLocked(current, now));
+    if (ret != 0) {
+        /* no scheduler: set the target at once */
+        mActive = false;
+        ret = writeLocked(target);
+    }
+    pthread_mutex_unlock(&mRampMutex);
+
+    return ret;
+}
+
+/**
+ * Stop the transition in progress. Once returned, no more step is
+ * written, and the level is considered unknown as the device is about to
+ * be driven by someone else.
+ */
+void LightsRamp::stop()
+{
+    pthread_mutex_lock(&mRampMutex);
+    if (mActive) {
+        mActive = false;
+        LightsScheduler::getInstance()->cancel(this);
+    }
+    mLevel = -1;
+    pthread_mutex_unlock(&mRampMutex);
+}
+
+/**
+ * Write one transition step
+ * @param now = current monotonic time in nanoseconds
+ * @return next step deadline, -1 once the target is reached
+ */
+int64_t LightsRamp::onDeadline(int64_t now)
+{
+    int64_t next = -1;
+
+    pthread_mutex_lock(&mRampMutex);
+    if (!mActive) {
+        pthread_mutex_unlock(&mRampMutex);
+        return -1;
+    }
+
+    long int level = getLevelLocked(now);
+    if (writeLocked(level) != 0) {
+        LOG(ERROR) << "Cannot set ramp level on " << mLed->getName();
+    } else {
+        next = getNextStepLocked(level, now);
+    }
+    if (next < 0) {
+        mActive = false;
+    }
+    pthread_mutex_unlock(&mRampMutex);
+
+    return next;
+}
+
+/**
+ * Stop, the scheduler could not queue the next step
+ */
+void LightsRamp::onUnscheduled()
+{
+    pthread_mutex_lock(&mRampMutex);
+    mActive = false;
+    pthread_mutex_unlock(&mRampMutex);
+}
+
+/**
+ * Print transition statistics
+ * @param fd = output file descriptor
+ */
+void LightsRamp::dump(int fd)
+{
+    dprintf(fd, "    ramp: period=%lldms ramps=%llu retargets=%llu steps=%llu\n",
+            (long long)(mPeriod / ONE_MS_IN_NS),
+            (unsigned long long)mRamps.load(std::memory_order_relaxed),
+            (unsigned long long)mRetargets.load(std::memory_order_relaxed),
+            (unsigned long long)mSteps.load(std::memory_order_relaxed));
+}
+
+}  // namespace light
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) 2024 STMicroelectronics
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "LightsLed.h"
+#include "LightsScheduler.h"
+
+#include <atomic>
+#include <pthread.h>
+#include <stdint.h>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace light {
+
+/**
+ * Brightness transition of one device, driven by the LightsScheduler
+ * thread.
+ *
+ * The brightness is interpolated from the current level to the target
+ * over the requested duration. Steps are at least one update period
+ * apart, and a step is only due when the interpolated value reaches the
+ * next hardware level, so a transition costs at most
+ * min(level delta, duration / period + 1) writes. A new target retargets
+ * the transition from the level reached, without jumping back.
+ */
+class alignas(LIGHTS_CACHE_LINE_SIZE) LightsRamp : public LightsSchedulerTask {
+    private:
+        pthread_mutex_t mRampMutex;
+        LightsLed* mLed;
+        int64_t mPeriod;
+        bool mActive = false;
+        long int mLevel = -1;
+        long int mFrom = 0;
+        long int mTo = 0;
+        int64_t mStartTime = 0;
+        int64_t mDuration = 0;
+        std::atomic<uint64_t> mRamps{0};
+        std::atomic<uint64_t> mRetargets{0};
+        std::atomic<uint64_t> mSteps{0};
+
+        long int getLevelLocked(int64_t time);
+        int64_t getNextStepLocked(long int level, int64_t now);
+        int writeLocked(long int level);
+    public:
+        LightsRamp(LightsLed* led, int rateHz);
+        ~LightsRamp();
+        int rampTo(long int target, int durationMs);
+        void stop();
+        int64_t onDeadline(int64_t now) override;
+        void onUnscheduled() override;
+        void dump(int fd);
+};
+
+}  // namespace light
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
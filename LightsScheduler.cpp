@@ -0,0 +1,681 @@
+/*
+ * Copyright (C) 2024 STMicroelectronics
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "LightsScheduler.h"
+
+#include <android-base/logging.h>
+#include <android-base/properties.h>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace light {
+
+static int64_t const ONE_S_IN_NS = 1000000000LL;
+static int64_t const ONE_MS_IN_NS = 1000000LL;
+static int const MAX_TIMER_SLACK_MS = 100;
+static int const MIN_STACK_KB = 16;
+static int const MAX_STACK_KB = 1024;
+
+static const struct {
+    const char* name;
+    int policy;
+} POLICIES[] = {
+    {"other", SCHED_OTHER},
+    {"fifo", SCHED_FIFO},
+    {"rr", SCHED_RR},
+};
+
+LightsScheduler::LightsScheduler()
+{
+    pthread_mutex_init(&mStartMutex, nullptr);
+    initMutex(&mHeapMutex);
+    setSlack(::android::base::GetIntProperty("ro.vendor.lights.timer_slack_ms", 0, 0,
+                                             MAX_TIMER_SLACK_MS) * ONE_MS_IN_NS);
+
+    CPU_ZERO(&mCpus);
+    mCpuList[0] = '\0';
+    if (configure(::android::base::GetProperty("ro.vendor.lights.sched.policy", "other").c_str(),
+                  ::android::base::GetIntProperty("ro.vendor.lights.sched.priority", 1),
+                  ::android::base::GetProperty("ro.vendor.lights.sched.cpus", "").c_str(),
+                  ::android::base::GetIntProperty("ro.vendor.lights.sched.stack_kb", 0),
+                  ::android::base::GetBoolProperty("ro.vendor.lights.sched.mlock", false)) != 0) {
+        LOG(ERROR) << "Invalid ro.vendor.lights.sched properties, scheduler thread not hardened";
+        configure("other", 0, "", 0, false);
+    }
+}
+
+/**
+ * Initialize a mutex taken by the scheduler thread and the binder threads.
+ * It inherits the priority of its waiters, so that a realtime scheduler
+ * thread is not delayed by a preempted thread holding it.
+ * @param mutex
+ */
+void LightsScheduler::initMutex(pthread_mutex_t* mutex)
+{
+    pthread_mutexattr_t attr;
+
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_setprotocol(&attr, PTHREAD_PRIO_INHERIT);
+    pthread_mutex_init(mutex, &attr);
+    pthread_mutexattr_destroy(&attr);
+}
+
+/**
+ * Parse a CPU list
+ * @param list = CPU numbers and ranges, e.g. "0-1,3"
+ * @param cpus = parsed set
+ * @return 0 if success, error code otherwise
+ */
+static int parseCpuList(const char* list, cpu_set_t* cpus)
+{
+    const char* p = list;
+
+    CPU_ZERO(cpus);
+    while (*p != '\0') {
+        char* end;
+        long int first = strtol(p, &end, 10);
+        long int last = first;
+
+        if ((end == p) || (first < 0)) {
+            return -1;
+        }
+        p = end;
+        if (*p == '-') {
+            last = strtol(p + 1, &end, 10);
+            if ((end == p + 1) || (last < first)) {
+                return -1;
+            }
+            p = end;
+        }
+        if (last >= CPU_SETSIZE) {
+            return -1;
+        }
+        for (long int cpu = first; cpu <= last; cpu++) {
+            CPU_SET(cpu, cpus);
+        }
+        if (*p == ',') {
+            p++;
+        } else if (*p != '\0') {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Set the realtime settings of the scheduler thread, before it starts.
+ * The service reads them from the ro.vendor.lights.sched.* properties.
+ * @param policy = "other", "fifo" or "rr"
+ * @param priority = realtime priority, ignored with "other"
+ * @param cpus = CPUs the thread runs on, e.g. "0-1,3", empty for all
+ * @param stackKb = size of a stack faulted in before start, 0 for the default stack
+ * @param lockMemory = lock the current and future memory of the process
+ * @return 0 if success, error code otherwise (invalid setting, already started)
+ */
+int LightsScheduler::configure(const char* policy, int priority, const char* cpus, int stackKb,
+                               bool lockMemory)
+{
+    int newPolicy = -1;
+    cpu_set_t newCpus;
+    long int page = sysconf(_SC_PAGESIZE);
+    int ret = 0;
+
+    for (const auto& entry : POLICIES) {
+        if (strcmp(policy, entry.name) == 0) {
+            newPolicy = entry.policy;
+        }
+    }
+    if (newPolicy < 0) {
+        LOG(ERROR) << "Unknown scheduler policy " << policy;
+        return -1;
+    }
+    if ((newPolicy != SCHED_OTHER) && ((priority < sched_get_priority_min(newPolicy)) ||
+                                       (priority > sched_get_priority_max(newPolicy)))) {
+        LOG(ERROR) << "Invalid " << policy << " priority " << priority;
+        return -1;
+    }
+    if ((parseCpuList(cpus, &newCpus) != 0) || (strlen(cpus) >= sizeof(mCpuList)) ||
+        ((cpus[0] != '\0') && (CPU_COUNT(&newCpus) == 0))) {
+        LOG(ERROR) << "Invalid scheduler CPU list " << cpus;
+        return -1;
+    }
+    if ((stackKb != 0) && ((stackKb < MIN_STACK_KB) || (stackKb > MAX_STACK_KB))) {
+        LOG(ERROR) << "Invalid scheduler stack size " << stackKb << "kB";
+        return -1;
+    }
+
+    pthread_mutex_lock(&mStartMutex);
+    if (mState.load(std::memory_order_acquire) != STATE_IDLE) {
+        LOG(ERROR) << "Scheduler already started, realtime settings not changed";
+        ret = -1;
+    } else {
+        mPolicy = newPolicy;
+        mPriority = (newPolicy != SCHED_OTHER) ? priority : 0;
+        mCpus = newCpus;
+        snprintf(mCpuList, sizeof(mCpuList), "%s", cpus);
+        mStackSize = ((size_t)stackKb * 1024 + page - 1) / page * page;
+        mLockMemory = lockMemory;
+    }
+    pthread_mutex_unlock(&mStartMutex);
+
+    return ret;
+}
+
+/**
+ * Get the scheduler instance, created on first call. The thread is only
+ * started by start() or the first schedule().
+ * @return scheduler
+ */
+LightsScheduler* LightsScheduler::getInstance()
+{
+    static LightsScheduler sScheduler;
+    return &sScheduler;
+}
+
+/**
+ * Get current timestamp in nanoseconds
+ * @return time in nanoseconds
+ */
+int64_t LightsScheduler::getTimestampMonotonic()
+{
+    struct timespec ts = {0, 0};
+
+    if (!clock_gettime(CLOCK_MONOTONIC, &ts)) {
+        return ONE_S_IN_NS * ts.tv_sec + ts.tv_nsec;
+    }
+
+    return -1;
+}
+
+/**
+ * Map the thread stack, with a guard page below it, and fault it in
+ * @return stack, nullptr on error
+ */
+void* LightsScheduler::allocStack()
+{
+    size_t page = sysconf(_SC_PAGESIZE);
+    char* base = static_cast<char*>(mmap(nullptr, mStackSize + page, PROT_READ | PROT_WRITE,
+                                         MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK | MAP_POPULATE,
+                                         -1, 0));
+
+    if (base == MAP_FAILED) {
+        return nullptr;
+    }
+    if (mprotect(base, page, PROT_NONE) != 0) {
+        munmap(base, mStackSize + page);
+        return nullptr;
+    }
+
+    return base + page;
+}
+
+/**
+ * Apply the realtime settings to the calling (scheduler) thread. The
+ * memory is locked before the policy is raised, so that faulting it in
+ * does not run at realtime priority.
+ */
+void LightsScheduler::applyRealtime()
+{
+    int failures = 0;
+
+    if ((mCpuList[0] != '\0') && (sched_setaffinity(0, sizeof(mCpus), &mCpus) != 0)) {
+        PLOG(WARNING) << "Cannot run the lights scheduler on CPUs " << mCpuList;
+        failures |= RT_FAILED_AFFINITY;
+    }
+
+    if (mLockMemory && (mlockall(MCL_CURRENT | MCL_FUTURE) != 0)) {
+        PLOG(WARNING) << "Cannot lock the lights service memory";
+        failures |= RT_FAILED_MLOCK;
+    }
+
+    if (mPolicy != SCHED_OTHER) {
+        struct sched_param param;
+
+        memset(&param, 0, sizeof(param));
+        param.sched_priority = mPriority;
+        int ret = pthread_setschedparam(pthread_self(), mPolicy, &param);
+        if (ret != 0) {
+            LOG(WARNING) << "Cannot set the lights scheduler priority: " << strerror(ret);
+            failures |= RT_FAILED_POLICY;
+        }
+    }
+
+    mRealtimeFailures.fetch_or(failures, std::memory_order_relaxed);
+}
+
+static void* execLoop(void *arg) {
+    LightsScheduler* _this = static_cast<LightsScheduler*>(arg);
+    _this->loop();
+    return nullptr;
+}
+
+/**
+ * Create the timer, event and epoll descriptors and start the thread
+ * @return 0 if success, error code otherwise
+ */
+int LightsScheduler::init()
+{
+    struct epoll_event ev;
+    pthread_attr_t attr;
+    int ret = 0;
+
+    mTimerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (mTimerFd < 0) {
+        PLOG(ERROR) << "Cannot create the scheduler timerfd";
+        return -1;
+    }
+
+    mEventFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (mEventFd < 0) {
+        PLOG(ERROR) << "Cannot create the scheduler eventfd";
+        goto close_timer;
+    }
+
+    mEpollFd = epoll_create1(EPOLL_CLOEXEC);
+    if (mEpollFd < 0) {
+        PLOG(ERROR) << "Cannot create the scheduler epoll";
+        goto close_event;
+    }
+
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.fd = mTimerFd;
+    if (epoll_ctl(mEpollFd, EPOLL_CTL_ADD, mTimerFd, &ev) != 0) {
+        PLOG(ERROR) << "Cannot add the timerfd to the scheduler epoll";
+        goto close_epoll;
+    }
+    ev.data.fd = mEventFd;
+    if (epoll_ctl(mEpollFd, EPOLL_CTL_ADD, mEventFd, &ev) != 0) {
+        PLOG(ERROR) << "Cannot add the eventfd to the scheduler epoll";
+        goto close_epoll;
+    }
+
+    pthread_attr_init(&attr);
+    if (mStackSize > 0) {
+        mStack = allocStack();
+        if (mStack == nullptr) {
+            PLOG(WARNING) << "Cannot map the scheduler stack, using the default one";
+            mRealtimeFailures.fetch_or(RT_FAILED_STACK, std::memory_order_relaxed);
+        } else {
+            pthread_attr_setstack(&attr, mStack, mStackSize);
+        }
+    }
+
+    mStartTime = getTimestampMonotonic();
+    ret = pthread_create(&mThread, &attr, execLoop, this);
+    pthread_attr_destroy(&attr);
+    if (ret != 0) {
+        LOG(ERROR) << "Cannot create the scheduler thread";
+        if (mStack != nullptr) {
+            munmap(static_cast<char*>(mStack) - sysconf(_SC_PAGESIZE),
+                   mStackSize + sysconf(_SC_PAGESIZE));
+            mStack = nullptr;
+        }
+        goto close_epoll;
+    }
+    pthread_setname_np(mThread, "lights-sched");
+    mState.store(STATE_RUNNING, std::memory_order_release);
+
+    return 0;
+
+close_epoll:
+    close(mEpollFd);
+    mEpollFd = -1;
+close_event:
+    close(mEventFd);
+    mEventFd = -1;
+close_timer:
+    close(mTimerFd);
+    mTimerFd = -1;
+    return -1;
+}
+
+/**
+ * Start the scheduler thread, unless already done (thread safe). Only the
+ * first calls take the start mutex.
+ * @return 0 if running, error code otherwise
+ */
+int LightsScheduler::start()
+{
+    int state = mState.load(std::memory_order_acquire);
+
+    if (state == STATE_IDLE) {
+        pthread_mutex_lock(&mStartMutex);
+        state = mState.load(std::memory_order_acquire);
+        if (state == STATE_IDLE) {
+            int64_t begin = getTimestampMonotonic();
+            if (init() != 0) {
+                LOG(ERROR) << "Cannot initialize the lights scheduler";
+                mState.store(STATE_FAILED, std::memory_order_release);
+            } else {
+                LOG(INFO) << "Lights scheduler started in "
+                          << (getTimestampMonotonic() - begin) / 1000 << "us";
+            }
+            state = mState.load(std::memory_order_acquire);
+        }
+        pthread_mutex_unlock(&mStartMutex);
+    }
+
+    return (state == STATE_RUNNING) ? 0 : -1;
+}
+
+void LightsScheduler::heapSwap(int a, int b)
+{
+    LightsSchedulerTask* tmp = mHeap[a];
+    mHeap[a] = mHeap[b];
+    mHeap[b] = tmp;
+    mHeap[a]->mHeapIndex = a;
+    mHeap[b]->mHeapIndex = b;
+}
+
+void LightsScheduler::heapSiftUp(int index)
+{
+    while (index > 0) {
+        int parent = (index - 1) / 2;
+        if (mHeap[parent]->mDeadline <= mHeap[index]->mDeadline) {
+            break;
+        }
+        heapSwap(parent, index);
+        index = parent;
+    }
+}
+
+void LightsScheduler::heapSiftDown(int index)
+{
+    for (;;) {
+        int smallest = index;
+        int left = 2 * index + 1;
+        int right = left + 1;
+
+        if ((left < mHeapSize) && (mHeap[left]->mDeadline < mHeap[smallest]->mDeadline)) {
+            smallest = left;
+        }
+        if ((right < mHeapSize) && (mHeap[right]->mDeadline < mHeap[smallest]->mDeadline)) {
+            smallest = right;
+        }
+        if (smallest == index) {
+            break;
+        }
+        heapSwap(index, smallest);
+        index = smallest;
+    }
+}
+
+void LightsScheduler::heapRemoveLocked(LightsSchedulerTask* task)
+{
+    int index = task->mHeapIndex;
+
+    if (index < 0) {
+        return;
+    }
+
+    mHeapSize--;
+    if (index != mHeapSize) {
+        heapSwap(index, mHeapSize);
+        heapSiftDown(index);
+        heapSiftUp(index);
+    }
+    task->mHeapIndex = -1;
+}
+
+/**
+ * Insert a task in the heap, or move it if already queued
+ * @param task
+ * @param deadline = absolute monotonic deadline in nanoseconds
+ * @return 0 if success, error code otherwise
+ */
+int LightsScheduler::heapInsertLocked(LightsSchedulerTask* task, int64_t deadline)
+{
+    if (task->mHeapIndex >= 0) {
+        task->mDeadline = deadline;
+        heapSiftDown(task->mHeapIndex);
+        heapSiftUp(task->mHeapIndex);
+        return 0;
+    }
+
+    if (mHeapSize >= MAX_TASKS) {
+        LOG(ERROR) << "Too many scheduled tasks";
+        return -1;
+    }
+
+    task->mDeadline = deadline;
+    task->mHeapIndex = mHeapSize;
+    mHeap[mHeapSize++] = task;
+    heapSiftUp(task->mHeapIndex);
+    return 0;
+}
+
+/**
+ * Wake up the scheduler thread so that it rearms its timer
+ */
+void LightsScheduler::notify()
+{
+    uint64_t value = 1;
+    if (write(mEventFd, &value, sizeof(value)) < 0 && errno != EAGAIN) {
+        PLOG(ERROR) << "Cannot notify the scheduler";
+    }
+}
+
+/**
+ * Schedule a task (thread safe)
+ * @param task
+ * @param deadline = absolute monotonic deadline in nanoseconds
+ * @return 0 if success, error code otherwise
+ */
+int LightsScheduler::schedule(LightsSchedulerTask* task, int64_t deadline)
+{
+    int ret;
+
+    if (start() != 0) {
+        return -1;
+    }
+
+    pthread_mutex_lock(&mHeapMutex);
+    task->mSeq++;
+    ret = heapInsertLocked(task, deadline);
+    pthread_mutex_unlock(&mHeapMutex);
+
+    if (ret == 0) {
+        notify();
+    }
+    return ret;
+}
+
+/**
+ * Unschedule a task (thread safe). A deadline callback already running
+ * is not waited for, the task is expected to guard its own state.
+ * @param task
+ */
+void LightsScheduler::cancel(LightsSchedulerTask* task)
+{
+    pthread_mutex_lock(&mHeapMutex);
+    task->mSeq++;
+    heapRemoveLocked(task);
+    pthread_mutex_unlock(&mHeapMutex);
+}
+
+/**
+ * Set the timer slack
+ * @param slack = tasks due within this delay after a wakeup run in it, in nanoseconds
+ */
+void LightsScheduler::setSlack(int64_t slack)
+{
+    mSlack.store((slack > 0) ? slack : 0, std::memory_order_relaxed);
+}
+
+/**
+ * Run the callback of every task whose deadline is reached, or within the
+ * timer slack
+ */
+void LightsScheduler::runExpired()
+{
+    int64_t slack = mSlack.load(std::memory_order_relaxed);
+
+    pthread_mutex_lock(&mHeapMutex);
+    for (;;) {
+        int64_t now = getTimestampMonotonic();
+        if ((mHeapSize == 0) || (mHeap[0]->mDeadline > now + slack)) {
+            break;
+        }
+
+        LightsSchedulerTask* task = mHeap[0];
+        uint32_t seq = task->mSeq;
+        int64_t deadline = task->mDeadline;
+        heapRemoveLocked(task);
+        pthread_mutex_unlock(&mHeapMutex);
+
+        mCallbacks.fetch_add(1, std::memory_order_relaxed);
+        if (deadline > now) {
+            /* run early: the task sees its own deadline */
+            mCoalesced.fetch_add(1, std::memory_order_relaxed);
+            now = deadline;
+        } else {
+            mWakeupLatency.record(now - deadline);
+        }
+        int64_t next = task->onDeadline(now);
+
+        pthread_mutex_lock(&mHeapMutex);
+        /* requeue only if nobody rescheduled or cancelled it meanwhile */
+        if ((next >= 0) && (task->mSeq == seq) && (heapInsertLocked(task, next) != 0)) {
+            pthread_mutex_unlock(&mHeapMutex);
+            task->onUnscheduled();
+            pthread_mutex_lock(&mHeapMutex);
+        }
+    }
+    pthread_mutex_unlock(&mHeapMutex);
+}
+
+/**
+ * Arm the timer on the earliest deadline, disarm it if nothing is queued
+ */
+void LightsScheduler::rearm()
+{
+    struct itimerspec spec;
+
+    memset(&spec, 0, sizeof(spec));
+
+    pthread_mutex_lock(&mHeapMutex);
+    if (mHeapSize > 0) {
+        int64_t deadline = mHeap[0]->mDeadline;
+        if (deadline <= 0) {
+            /* a zero it_value would disarm the timer */
+            deadline = 1;
+        }
+        spec.it_value.tv_sec = deadline / ONE_S_IN_NS;
+        spec.it_value.tv_nsec = deadline % ONE_S_IN_NS;
+    }
+    pthread_mutex_unlock(&mHeapMutex);
+
+    if (timerfd_settime(mTimerFd, TFD_TIMER_ABSTIME, &spec, nullptr) != 0) {
+        PLOG(ERROR) << "Cannot arm the scheduler timer";
+    }
+}
+
+void LightsScheduler::loop()
+{
+    struct epoll_event events[2];
+    uint64_t value;
+
+    LOG(INFO) << "Start lights scheduler";
+    applyRealtime();
+
+    for (;;) {
+        int n = epoll_wait(mEpollFd, events, 2, -1);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            PLOG(ERROR) << "Lights scheduler epoll_wait returned an error";
+            break;
+        }
+
+        mWakeups.fetch_add(1, std::memory_order_relaxed);
+        for (int i = 0; i < n; i++) {
+            /* drain the counters, both descriptors are non blocking */
+            if (read(events[i].data.fd, &value, sizeof(value)) < 0 && errno != EAGAIN) {
+                PLOG(ERROR) << "Cannot read scheduler event";
+            }
+        }
+
+        runExpired();
+        rearm();
+    }
+
+    mState.store(STATE_FAILED, std::memory_order_release);
+}
+
+/**
+ * Print wakeup statistics
+ * @param fd = output file descriptor
+ */
+void LightsScheduler::dump(int fd)
+{
+    int64_t elapsed = getTimestampMonotonic() - mStartTime;
+    uint64_t wakeups = mWakeups.load(std::memory_order_relaxed);
+
+    if (mState.load(std::memory_order_acquire) == STATE_IDLE) {
+        dprintf(fd, "Scheduler: not started\n");
+        return;
+    }
+
+    dprintf(fd, "Scheduler: slack=%lldms wakeups=%llu (%.2f/s) callbacks=%llu coalesced=%llu\n",
+            (long long)(mSlack.load(std::memory_order_relaxed) / ONE_MS_IN_NS),
+            (unsigned long long)wakeups,
+            (elapsed > 0) ? (double)wakeups * ONE_S_IN_NS / elapsed : 0.0,
+            (unsigned long long)mCallbacks.load(std::memory_order_relaxed),
+            (unsigned long long)mCoalesced.load(std::memory_order_relaxed));
+
+    const char* policy = "";
+    for (const auto& entry : POLICIES) {
+        if (entry.policy == mPolicy) {
+            policy = entry.name;
+        }
+    }
+    char stack[32] = "default";
+    if (mStack != nullptr) {
+        snprintf(stack, sizeof(stack), "%zukB prefaulted", mStackSize / 1024);
+    }
+    int failures = mRealtimeFailures.load(std::memory_order_relaxed);
+    dprintf(fd, "  realtime: policy=%s priority=%d cpus=%s stack=%s memory=%s%s%s%s%s%s\n",
+            policy, mPriority, (mCpuList[0] != '\0') ? mCpuList : "all", stack,
+            mLockMemory ? "locked" : "pageable",
+            (failures != 0) ? " failed:" : "",
+            (failures & RT_FAILED_POLICY) ? " policy" : "",
+            (failures & RT_FAILED_AFFINITY) ? " affinity" : "",
+            (failures & RT_FAILED_MLOCK) ? " mlock" : "",
+            (failures & RT_FAILED_STACK) ? " stack" : "");
+    mWakeupLatency.dump(fd, "wakeup latency");
+}
+
+}  // namespace light
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
@@ -0,0 +1,152 @@
+/*
+ * Copyright (C) 2024 STMicroelectronics
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "LightsConfig.h"
+#include "LightsStats.h"
+
+#include <atomic>
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stddef.h>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace light {
+
+class LightsScheduler;
+
+/**
+ * Work item driven by the scheduler thread.
+ */
+class LightsSchedulerTask {
+    friend class LightsScheduler;
+    private:
+        int mHeapIndex = -1;
+        int64_t mDeadline = 0;
+        uint32_t mSeq = 0;
+    public:
+        virtual ~LightsSchedulerTask() {}
+        /**
+         * Called from the scheduler thread once the deadline is reached
+         * @param now = current monotonic time in nanoseconds
+         * @return next absolute deadline in nanoseconds, -1 to unschedule
+         */
+        virtual int64_t onDeadline(int64_t now) = 0;
+        /**
+         * Called from the scheduler thread when the next deadline returned
+         * could not be queued: the task is no longer scheduled
+         */
+        virtual void onUnscheduled() {}
+};
+
+/**
+ * Single thread driving every scheduled task from a deadline min-heap,
+ * armed on an absolute timerfd. Schedule changes are notified through an
+ * eventfd, so callers never create or join a thread.
+ *
+ * With a timer slack (ro.vendor.lights.timer_slack_ms), the tasks due
+ * within the slack after a wakeup run in that wakeup, slightly early,
+ * instead of waking the thread again. Their callback gets their deadline
+ * as current time, so that they compute the same next deadline.
+ *
+ * The thread and its descriptors are created on first use, off the
+ * service startup path. Once started, the check is a single atomic load.
+ *
+ * So that edges stay on time on a loaded system, the thread can run with
+ * a realtime policy, on a subset of the CPUs, on a small stack faulted in
+ * before it starts, with the process memory locked (see configure()).
+ * The thread applies them itself when it starts, a setting refused by the
+ * kernel is logged and reported by the dump, the thread keeps running.
+ * The delay from each deadline to its callback is measured.
+ */
+class LightsScheduler {
+    public:
+        /* a flash, a pattern and a device transition per light at most */
+        static int const MAX_TASKS = 3 * LIGHTS_MAX_LIGHTS;
+    private:
+        enum RealtimeFailure {
+            RT_FAILED_POLICY = 1 << 0,
+            RT_FAILED_AFFINITY = 1 << 1,
+            RT_FAILED_MLOCK = 1 << 2,
+            RT_FAILED_STACK = 1 << 3,
+        };
+        enum State {
+            STATE_IDLE,
+            STATE_RUNNING,
+            STATE_FAILED,
+        };
+
+        pthread_t mThread;
+        pthread_mutex_t mStartMutex;
+        pthread_mutex_t mHeapMutex;
+        LightsSchedulerTask* mHeap[MAX_TASKS];
+        int mHeapSize = 0;
+        int mEpollFd = -1;
+        int mTimerFd = -1;
+        int mEventFd = -1;
+        std::atomic<int> mState{STATE_IDLE};
+        std::atomic<int64_t> mSlack{0};
+        int64_t mStartTime = 0;
+        std::atomic<uint64_t> mWakeups{0};
+        std::atomic<uint64_t> mCallbacks{0};
+        std::atomic<uint64_t> mCoalesced{0};
+        LightsHistogram mWakeupLatency;
+        int mPolicy = SCHED_OTHER;
+        int mPriority = 0;
+        cpu_set_t mCpus;
+        char mCpuList[64];
+        size_t mStackSize = 0;
+        void* mStack = nullptr;
+        bool mLockMemory = false;
+        std::atomic<int> mRealtimeFailures{0};
+
+        LightsScheduler();
+        int init();
+        void* allocStack();
+        void applyRealtime();
+        void heapSwap(int a, int b);
+        void heapSiftUp(int index);
+        void heapSiftDown(int index);
+        void heapRemoveLocked(LightsSchedulerTask* task);
+        int heapInsertLocked(LightsSchedulerTask* task, int64_t deadline);
+        void notify();
+        void runExpired();
+        void rearm();
+    public:
+        static LightsScheduler* getInstance();
+        static int64_t getTimestampMonotonic();
+        static void initMutex(pthread_mutex_t* mutex);
+        int configure(const char* policy, int priority, const char* cpus, int stackKb,
+                      bool lockMemory);
+        int start();
+        bool isRunning() const { return mState.load(std::memory_order_acquire) == STATE_RUNNING; }
+        int schedule(LightsSchedulerTask* task, int64_t deadline);
+        void cancel(LightsSchedulerTask* task);
+        void setSlack(int64_t slack);
+        uint64_t getWakeups() const { return mWakeups.load(std::memory_order_relaxed); }
+        const LightsHistogram& getWakeupLatency() const { return mWakeupLatency; }
+        void loop();
+        void dump(int fd);
+};
+
+}  // namespace light
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
@@ -0,0 +1,163 @@
+/*
+ * Copyright (C) 2024 STMicroelectronics
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "LightsConfig.h"
+
+#include <atomic>
+#include <stdint.h>
+#include <stdio.h>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace light {
+
+/**
+ * Log2 bucketed histogram of durations, in microseconds.
+ * Bucket 0 counts values below 1us, bucket i values in [2^(i-1), 2^i) us,
+ * the last bucket everything above. Updated with relaxed atomics.
+ */
+class LightsHistogram {
+    public:
+        static int const NB_BUCKETS = 20;
+    private:
+        std::atomic<uint32_t> mBuckets[NB_BUCKETS] = {};
+        std::atomic<uint64_t> mCount{0};
+        std::atomic<int64_t> mSumNs{0};
+        std::atomic<int64_t> mMaxNs{0};
+    public:
+        void record(int64_t ns) {
+            int bucket = 0;
+            int64_t us = (ns > 0) ? ns / 1000 : 0;
+
+            while ((us > 0) && (bucket < NB_BUCKETS - 1)) {
+                us >>= 1;
+                bucket++;
+            }
+            mBuckets[bucket].fetch_add(1, std::memory_order_relaxed);
+            mCount.fetch_add(1, std::memory_order_relaxed);
+            mSumNs.fetch_add(ns, std::memory_order_relaxed);
+
+            int64_t max = mMaxNs.load(std::memory_order_relaxed);
+            while ((ns > max) &&
+                   !mMaxNs.compare_exchange_weak(max, ns, std::memory_order_relaxed)) {
+            }
+        }
+
+        void reset() {
+            for (int i = 0; i < NB_BUCKETS; i++) {
+                mBuckets[i].store(0, std::memory_order_relaxed);
+            }
+            mCount.store(0, std::memory_order_relaxed);
+            mSumNs.store(0, std::memory_order_relaxed);
+            mMaxNs.store(0, std::memory_order_relaxed);
+        }
+
+        uint64_t getCount() const { return mCount.load(std::memory_order_relaxed); }
+        int64_t getMaxNs() const { return mMaxNs.load(std::memory_order_relaxed); }
+
+        /**
+         * Get an upper bound of a percentile, from the buckets
+         * @param pct = percentile, 0..100
+         * @return bound in microseconds, 0 if empty, -1 if in the last bucket
+         */
+        int64_t getPercentileUs(double pct) const {
+            uint64_t count = getCount();
+            uint64_t rank = (uint64_t)(count * pct / 100);
+            uint64_t seen = 0;
+
+            if (count == 0) {
+                return 0;
+            }
+            for (int i = 0; i < NB_BUCKETS - 1; i++) {
+                seen += mBuckets[i].load(std::memory_order_relaxed);
+                if (seen > rank) {
+                    return (i == 0) ? 1 : 1LL << i;
+                }
+            }
+            return -1;
+        }
+
+        /**
+         * Print the histogram, one line, non empty buckets only
+         * @param fd = output file descriptor
+         * @param name = histogram name
+         */
+        void dump(int fd, const char* name) const {
+            uint64_t count = getCount();
+
+            dprintf(fd, "    %s: count=%llu", name, (unsigned long long)count);
+            if (count == 0) {
+                dprintf(fd, "\n");
+                return;
+            }
+            dprintf(fd, " avg=%lldus max=%lldus |",
+                    (long long)(mSumNs.load(std::memory_order_relaxed) / (int64_t)count / 1000),
+                    (long long)(mMaxNs.load(std::memory_order_relaxed) / 1000));
+            for (int i = 0; i < NB_BUCKETS; i++) {
+                uint32_t n = mBuckets[i].load(std::memory_order_relaxed);
+                if (n == 0) {
+                    continue;
+                }
+                if (i == 0) {
+                    dprintf(fd, " <1us:%u", n);
+                } else if (i == NB_BUCKETS - 1) {
+                    dprintf(fd, " >=%lldus:%u", 1LL << (i - 1), n);
+                } else {
+                    dprintf(fd, " <%lldus:%u", 1LL << i, n);
+                }
+            }
+            dprintf(fd, "\n");
+        }
+};
+
+/**
+ * Call counters and latency of one entry point, updated with relaxed
+ * atomics.
+ */
+class LightsCallStats {
+    private:
+        std::atomic<uint64_t> mCalls{0};
+        std::atomic<uint64_t> mErrors{0};
+        LightsHistogram mLatency;
+    public:
+        void record(bool error, int64_t ns) {
+            mCalls.fetch_add(1, std::memory_order_relaxed);
+            if (error) {
+                mErrors.fetch_add(1, std::memory_order_relaxed);
+            }
+            mLatency.record(ns);
+        }
+
+        /**
+         * Print the counters and the latency histogram
+         * @param fd = output file descriptor
+         * @param name = entry point name
+         */
+        void dump(int fd, const char* name) const {
+            dprintf(fd, "    %s: calls=%llu errors=%llu\n", name,
+                    (unsigned long long)mCalls.load(std::memory_order_relaxed),
+                    (unsigned long long)mErrors.load(std::memory_order_relaxed));
+            mLatency.dump(fd, "latency");
+        }
+};
+
+}  // namespace light
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
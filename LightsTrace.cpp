@@ -0,0 +1,153 @@
+/*
+ * Copyright (C) 2024 STMicroelectronics
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "LightsTrace.h"
+#include "LightsScheduler.h"
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace light {
+
+static_assert((LightsTrace::RING_SIZE & (LightsTrace::RING_SIZE - 1)) == 0,
+              "ring size must be a power of 2");
+
+/*
+ * Fields are relaxed atomics so that the dump may read a ring while its
+ * thread writes it: a record overwritten during the copy is discarded.
+ * The writer claims a slot (head) before writing it and commits it after,
+ * both fenced, so that a reader seeing any part of a new record also sees
+ * the head moved past the record it overwrites.
+ */
+struct LightsTraceRecord {
+    std::atomic<int64_t> time;
+    std::atomic<uint64_t> data; // event << 48 | id << 32 | arg
+};
+
+struct LightsTraceRing {
+    std::atomic<uint64_t> head;      // records claimed
+    std::atomic<uint64_t> committed; // records written
+    std::atomic<int> tid;
+    LightsTraceRecord records[LightsTrace::RING_SIZE];
+};
+
+static LightsTraceRing sRings[LightsTrace::MAX_RINGS];
+static std::atomic<int> sNbRings{0};
+static std::atomic<uint64_t> sDropped{0};
+static thread_local LightsTraceRing* sRing = nullptr;
+static thread_local bool sUntraced = false;
+
+/**
+ * Get the ring of the calling thread, taken from the pool on first call
+ * @return ring, nullptr if the pool is exhausted
+ */
+static LightsTraceRing* getRing()
+{
+    if ((sRing == nullptr) && !sUntraced) {
+        int index = sNbRings.fetch_add(1, std::memory_order_relaxed);
+        if (index < LightsTrace::MAX_RINGS) {
+            sRing = &sRings[index];
+            sRing->tid.store((int)syscall(SYS_gettid), std::memory_order_release);
+        } else {
+            sNbRings.store(LightsTrace::MAX_RINGS, std::memory_order_relaxed);
+            sUntraced = true;
+        }
+    }
+    return sRing;
+}
+
+/**
+ * Record an event in the ring of the calling thread
+ * @param event = event type
+ * @param id = light or led index
+ * @param arg = event argument
+ */
+void LightsTrace::record(LightsTraceEvent event, int id, uint32_t arg)
+{
+    LightsTraceRing* ring = getRing();
+    if (ring == nullptr) {
+        sDropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    uint64_t head = ring->head.load(std::memory_order_relaxed);
+    ring->head.store(head + 1, std::memory_order_relaxed);
+    /* the claim is visible before any store to the slot */
+    std::atomic_thread_fence(std::memory_order_release);
+
+    LightsTraceRecord* r = &ring->records[head & (RING_SIZE - 1)];
+    r->time.store(LightsScheduler::getTimestampMonotonic(), std::memory_order_relaxed);
+    r->data.store(((uint64_t)event << 48) | ((uint64_t)(id & 0xffff) << 32) | arg,
+                  std::memory_order_relaxed);
+    ring->committed.store(head + 1, std::memory_order_release);
+}
+
+/**
+ * Print the recorded events, one line per event:
+ * "<tid> <time ns> <event> <id> <arg>", ring by ring, oldest first
+ * @param fd = output file descriptor
+ */
+void LightsTrace::dump(int fd)
+{
+    int nbRings = sNbRings.load(std::memory_order_relaxed);
+    if (nbRings > MAX_RINGS) {
+        nbRings = MAX_RINGS;
+    }
+
+    dprintf(fd, "Trace: v1 rings=%d dropped=%llu\n", nbRings,
+            (unsigned long long)sDropped.load(std::memory_order_relaxed));
+
+    for (int i = 0; i < nbRings; i++) {
+        LightsTraceRing* ring = &sRings[i];
+        int64_t times[RING_SIZE];
+        uint64_t datas[RING_SIZE];
+
+        uint64_t end = ring->committed.load(std::memory_order_acquire);
+        uint64_t begin = (end > RING_SIZE) ? end - RING_SIZE : 0;
+        for (uint64_t n = begin; n < end; n++) {
+            times[n & (RING_SIZE - 1)] = ring->records[n & (RING_SIZE - 1)].time.load(
+                    std::memory_order_relaxed);
+            datas[n & (RING_SIZE - 1)] = ring->records[n & (RING_SIZE - 1)].data.load(
+                    std::memory_order_relaxed);
+        }
+
+        /* slot loads done before reading the claims: keep the records no
+           claim made during the copy has overwritten */
+        std::atomic_thread_fence(std::memory_order_acquire);
+        uint64_t head = ring->head.load(std::memory_order_relaxed);
+        if (head > begin + RING_SIZE) {
+            begin = head - RING_SIZE;
+        }
+
+        int tid = ring->tid.load(std::memory_order_acquire);
+        for (uint64_t n = begin; n < end; n++) {
+            uint64_t data = datas[n & (RING_SIZE - 1)];
+            dprintf(fd, "%d %lld %u %u %u\n", tid, (long long)times[n & (RING_SIZE - 1)],
+                    (unsigned)(data >> 48), (unsigned)((data >> 32) & 0xffff),
+                    (unsigned)(data & 0xffffffff));
+        }
+    }
+}
+
+}  // namespace light
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2024 STMicroelectronics
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <stdint.h>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace light {
+
+/**
+ * Trace event types. Keep in sync with tools/lights_trace.py.
+ */
+enum class LightsTraceEvent : uint16_t {
+    SET_LIGHT_STATE = 1,      // id = light, arg = color
+    SET_LIGHT_STATE_DONE = 2, // id = light, arg = exception code
+    FLASH_START = 3,          // id = light, arg = on duration (ms)
+    FLASH_STOP = 4,           // id = light
+    FLASH_EDGE = 5,           // id = light, arg = color
+    LED_COLOR = 6,            // id = led, arg = brightness
+    LED_BACKLIGHT = 7,        // id = led, arg = brightness
+    LED_KERNEL_FLASH = 8,     // id = led, arg = backend
+    LED_RAMP = 9,             // id = led, arg = target brightness
+    LED_WRITE_ERROR = 10,     // id = led, arg = errno
+    PATTERN_START = 11,       // id = light, arg = backend
+    PATTERN_STOP = 12,        // id = light
+    SET_LIGHT_STATES = 13,    // id = number of updates
+    SET_LIGHT_STATES_DONE = 14, // id = number of updates, arg = exception code
+    FLASH_RETIME = 15,        // id = light, arg = on duration (ms)
+};
+
+/**
+ * In-memory event trace.
+ *
+ * Each thread records into its own fixed ring of timestamped events,
+ * taken from a static pool on first use: recording is a clock read, a
+ * release fence and four relaxed or release stores (slot claim, time,
+ * data, commit), without lock nor allocation. Rings are never returned
+ * to the pool, even when their thread exits: once MAX_RINGS threads
+ * have recorded, later threads (binder threads started late included)
+ * are not traced, their events are counted as dropped. The oldest
+ * events of a ring are overwritten.
+ *
+ * The rings are printed on demand, one event per line, and decoded on
+ * host by tools/lights_trace.py.
+ */
+class LightsTrace {
+    public:
+        static int const RING_SIZE = 256;
+        static int const MAX_RINGS = 16;
+
+        static void record(LightsTraceEvent event, int id, uint32_t arg);
+        static void dump(int fd);
+};
+
+}  // namespace light
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
@@ -14,289 +14,513 @@
  * limitations under the License.
  */
 
+#include <dirent.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <limits.h>
 #include <pthread.h>
 #include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <algorithm>
+#include <string>
 #include <vector>
 
 #include "Lights.h"
+#include "LightsConfig.h"
+#include "LightsTrace.h"
 
 #include <android-base/logging.h>
+#include <android-base/properties.h>
 
 namespace aidl {
 namespace android {
 namespace hardware {
 namespace light {
 
-char const* const LED_TRIGGER = "/sys/class/leds/%s/trigger";
-char const* const LED_BRIGHTNESS = "/sys/class/leds/%s/brightness";
-char const* const LED_MAX_BRIGHTNESS = "/sys/class/leds/%s/max_brightness";
-
-// char const* const LED_RED_NAME = "red";
-char const* const LED_BLUE_NAME = "blue:heartbeat";
+char const* const LEDS_CLASS = "%s/class/leds";
+char const* const BACKLIGHT_CLASS = "%s/class/backlight";
 
 char const* const LED_HW_TRIGGER_ON = "heartbeat";
 char const* const LED_HW_TRIGGER_OFF = "none";
 
-char const* const BACKLIGHT_BRIGHTNESS = "/sys/class/backlight/panel-lvds-backlight/brightness";
-char const* const BACKLIGHT_MAX_BRIGHTNESS = "/sys/class/backlight/panel-lvds-backlight/max_brightness";
+char const* const SYSFS_ROOT_DEFAULT = "/sys";
+char const* const LIGHTS_CONFIG_DEFAULT = "/vendor/etc/lights/lights-stm32mpu.conf";
+
+static char sSysfsRoot[PATH_MAX];
+static bool sKernelBlink = true;
+static bool sHotplug = false;
+static LightsCurve sLedCurve = LightsCurve::LINEAR;
+
+/* one device per light at most */
+static int const MAX_LEDS = LIGHTS_MAX_LIGHTS;
+
+static pthread_mutex_t sLedsMutex = PTHREAD_MUTEX_INITIALIZER;
+static LightsLed* sLeds[MAX_LEDS];
+
+/* light types exposed by the service, in id order */
+static LightType const LIGHT_TYPES[] = {
+    LightType::BACKLIGHT,
+    LightType::KEYBOARD,
+    LightType::BUTTONS,
+    LightType::BATTERY,
+    LightType::NOTIFICATIONS,
+    LightType::ATTENTION,
+    LightType::BLUETOOTH,
+    LightType::WIFI,
+    LightType::MICROPHONE,
+};
 
+/*
+ * Default mapping, used without vendor configuration file: board devices
+ * first, then kernel led function names ("<color>:<function>")
+ */
+static struct {
+    LightType type;
+    const char* device;
+} const DEFAULT_MAPPING[] = {
+    { LightType::BACKLIGHT, "panel-lvds-backlight" },
+    { LightType::NOTIFICATIONS, "blue:heartbeat" },
+    { LightType::ATTENTION, "blue:heartbeat" },
+};
+
+static struct {
+    LightType type;
+    const char* function;
+} const DEFAULT_FUNCTIONS[] = {
+    { LightType::BACKLIGHT, "backlight" },
+    { LightType::KEYBOARD, "kbd_backlight" },
+    { LightType::BUTTONS, "buttons" },
+    { LightType::BATTERY, "charging" },
+    { LightType::BATTERY, "battery" },
+    { LightType::NOTIFICATIONS, "indicator" },
+    { LightType::ATTENTION, "alert" },
+    { LightType::BLUETOOTH, "bluetooth" },
+    { LightType::WIFI, "wlan" },
+    { LightType::MICROPHONE, "micmute" },
+};
 
 /**
- * Get led name associated to required light type
- * @param type
- * @return name
+ * Override the sysfs mount point, to be called before any light access
+ * (used to run on a fake sysfs tree)
+ * @param root = sysfs root directory
  */
-const char* LightsUtils::getLedName(LightType type)
+void LightsUtils::setSysfsRoot(const char* root)
 {
-    switch (type) {
-        case LightType::NOTIFICATIONS:
-            return LED_BLUE_NAME;
-        case LightType::ATTENTION:
-            return LED_BLUE_NAME;
-        default:
-            return nullptr;
+    snprintf(sSysfsRoot, sizeof(sSysfsRoot), "%s", root);
+}
+
+/**
+ * Get the sysfs mount point, ro.vendor.lights.sysfs_root if not overridden
+ * @return sysfs root directory
+ */
+const char* LightsUtils::getSysfsRoot()
+{
+    if (sSysfsRoot[0] == '\0') {
+        std::string root = ::android::base::GetProperty("ro.vendor.lights.sysfs_root",
+                                                        SYSFS_ROOT_DEFAULT);
+        setSysfsRoot(root.c_str());
     }
+    return sSysfsRoot;
 }
 
 /**
- * Set the color value
- * 
- * @param led = name of the led in path
- * @param color = RGB color value
- * @param trigger = HW flash mode required ?
- * @return 0 if success, error code otherwise
+ * Get the cached handle of a led or backlight device
+ * @param device = name of the device in its class directory
+ * @param backlight = device is in the backlight class
+ * @return handle, nullptr if the led table is full
  */
-int LightsUtils::setColorValue(const char* led, int color, bool trigger)
+LightsLed* LightsUtils::getLed(const char* device, bool backlight)
 {
-    int fd = 0;
-    long int max_brightness = 255;
-    long int brightness = 0;
-    char path[64];
-    char buf[64] = {0};
-
-    /* get max led brightness */
-    snprintf(path, sizeof(path), LED_MAX_BRIGHTNESS, led);
-    // LOG(INFO) << "set color value " << std::hex << color << " for device path " << path;
-    fd = open(path, O_RDONLY);
-    if (fd < 0) {
-        PLOG(ERROR) << "Failed to open max brightness for device path " << path;
+    LightsLed* handle = nullptr;
+
+    pthread_mutex_lock(&sLedsMutex);
+    for (int i = 0; i < MAX_LEDS; i++) {
+        if (sLeds[i] == nullptr) {
+            char classDir[PATH_MAX];
+            char dir[PATH_MAX];
+            snprintf(classDir, sizeof(classDir), backlight ? BACKLIGHT_CLASS : LEDS_CLASS,
+                     getSysfsRoot());
+            snprintf(dir, sizeof(dir), "%s/%s", classDir, device);
+            /* the framework already maps the backlight level perceptually */
+            sLeds[i] = new LightsLed(i, device, dir, !backlight, backlight ? 1 : 255,
+                                        backlight ? LightsCurve::LINEAR : sLedCurve);
+        }
+        if (strcmp(sLeds[i]->getName(), device) == 0) {
+            handle = sLeds[i];
+            break;
+        }
+    }
+    pthread_mutex_unlock(&sLedsMutex);
+
+    if (handle == nullptr) {
+        LOG(ERROR) << "Too many leds, cannot handle " << device;
     }
+    return handle;
+}
+
+/**
+ * Get the handle of a device of the light table
+ * @param device = name of the device in its class directory
+ * @return handle, nullptr if the device is not used by a light
+ */
+LightsLed* LightsUtils::findLed(const char* device)
+{
+    LightsLed* handle = nullptr;
 
-    /* max brightness size fixed to 8 bytes */
-    ssize_t rb = read(fd, buf, 8);
-    close(fd);
-    if (rb < 0) {
-        PLOG(ERROR) << "Failed to read light max brightness " << path;
-    } else {
-        char* endptr;
-        long int ret = strtol(buf, &endptr, 10);
-        if ('\0' != *endptr && '\n' != *endptr) {
-            LOG(ERROR) << "max brightness: Error in string conversion";
-        } else {
-            max_brightness = ret;
+    pthread_mutex_lock(&sLedsMutex);
+    for (int i = 0; (i < MAX_LEDS) && (sLeds[i] != nullptr); i++) {
+        if (strcmp(sLeds[i]->getName(), device) == 0) {
+            handle = sLeds[i];
+            break;
         }
     }
-    // LOG(INFO) << "Max brightness read: " << max_brightness;
-
-    /* calculate brightness depending on color level requested (RGB) */
-    color = color & 0x00FFFFFF;
-    if (color > 1) {
-        brightness = ((77*((color>>16)&0x00ff)) + (150*((color>>8)&0x00ff)) + (29*(color&0x00ff))) >> 8;
-        if (brightness > max_brightness)
-            brightness = max_brightness;
-    } else {
-        brightness = (color==1) ? max_brightness : 0;
+    pthread_mutex_unlock(&sLedsMutex);
+
+    return handle;
+}
+
+/**
+ * List the devices of a sysfs class
+ * @param format = class directory format, completed with sysfs root
+ * @param devices = list to fill
+ */
+static void listDevices(const char* format, std::vector<std::string>* devices)
+{
+    char dir[PATH_MAX];
+
+    snprintf(dir, sizeof(dir), format, LightsUtils::getSysfsRoot());
+    DIR* d = opendir(dir);
+    if (d == nullptr) {
+        PLOG(INFO) << "No device in " << dir;
+        return;
     }
-    // LOG(INFO) << "Brightness set: " << brightness;
+    for (struct dirent* entry = readdir(d); entry != nullptr; entry = readdir(d)) {
+        if (entry->d_name[0] != '.') {
+            devices->push_back(entry->d_name);
+        }
+    }
+    closedir(d);
+    std::sort(devices->begin(), devices->end());
+}
 
-    /* set led trigger */
-    int size_w;
-    ssize_t wb;
-    snprintf(path, sizeof(path), LED_TRIGGER, led);
-    fd = open(path, O_RDWR);
-    if (fd < 0) {
-        PLOG(ERROR) << "Failed to open light trigger " << path;
-    } else {
-        if (trigger) {
-            size_w = snprintf(buf, 64, "%s", LED_HW_TRIGGER_ON);
-        } else {
-            size_w = snprintf(buf, 64, "%s", LED_HW_TRIGGER_OFF);
+/**
+ * Get the light type from its name
+ * @param name = light type name, as returned by getLightTypeName
+ * @param type = type found
+ * @return 0 if success, error code otherwise
+ */
+static int getLightType(const char* name, LightType* type)
+{
+    for (LightType t : LIGHT_TYPES) {
+        if (strcmp(LightsUtils::getLightTypeName(t), name) == 0) {
+            *type = t;
+            return 0;
         }
-        wb = write(fd, &buf, size_w*sizeof(char));
-        close(fd);
-        if (wb == -1) {
-            PLOG(ERROR) << "Failed to write light trigger " << path;
+    }
+    return -1;
+}
+
+/**
+ * Add a mapping if the device exists
+ * @param mappings = table to fill
+ * @param type = light type
+ * @param device = device name
+ * @param leds = devices of the leds class
+ * @param backlights = devices of the backlight class
+ * @param absent = also add a missing device, detached until plugged
+ * @return 0 if added, error code otherwise
+ */
+static int addMapping(std::vector<LightsMapping>* mappings, LightType type, const char* device,
+                      const std::vector<std::string>& leds,
+                      const std::vector<std::string>& backlights, bool absent = false)
+{
+    bool inLeds = std::find(leds.begin(), leds.end(), device) != leds.end();
+    bool inBacklights = std::find(backlights.begin(), backlights.end(), device) != backlights.end();
+    bool missing = !inLeds && !inBacklights;
+    int ordinal = 0;
+
+    if (missing) {
+        if (!absent) {
+            return -1;
         }
+        /* class unknown until plugged, assumed from the light type */
+        inBacklights = (type == LightType::BACKLIGHT);
+        inLeds = !inBacklights;
     }
 
-    /* set led brightness */
-    snprintf(path, sizeof(path), LED_BRIGHTNESS, led);
-    fd = open(path, O_RDWR);
-    if (fd < 0) {
-        PLOG(ERROR) << "Failed to open light brightness " << path;
+    for (auto i = mappings->begin(); i != mappings->end(); i++) {
+        if (i->type == type) {
+            if (strcmp(i->led->getName(), device) == 0) {
+                return 0;
+            }
+            ordinal++;
+        }
+    }
+
+    /* a backlight device is preferred for the backlight light */
+    bool backlight = inBacklights && (!inLeds || (type == LightType::BACKLIGHT));
+    LightsLed* led = LightsUtils::getLed(device, backlight);
+    if (led == nullptr) {
         return -1;
     }
+    if (missing) {
+        LOG(INFO) << "Light " << LightsUtils::getLightTypeName(type) << " waits for device "
+                  << device;
+        led->detach();
+    }
+
+    mappings->push_back({ type, ordinal, led });
+    return 0;
+}
+
+/**
+ * Read the vendor mapping file. Each line is "<LIGHT TYPE> <device>",
+ * e.g. "NOTIFICATIONS blue:heartbeat", '#' starts a comment.
+ * @param path = configuration file path
+ * @param mappings = table to fill
+ * @param leds = devices of the leds class
+ * @param backlights = devices of the backlight class
+ * @return 0 if success, error code if the file cannot be read
+ */
+static int readMappingFile(const char* path, std::vector<LightsMapping>* mappings,
+                           const std::vector<std::string>& leds,
+                           const std::vector<std::string>& backlights)
+{
+    char line[256];
+    char typeName[32];
+    char device[NAME_MAX + 1];
+    LightType type;
 
-    size_w = snprintf(buf, 64, "%d", (int)brightness);
-    wb = write(fd, &buf, size_w*sizeof(char));
-    close(fd);
-    if (wb == -1) {
-        PLOG(ERROR) << "Failed to write light brightness " << path;
+    FILE* file = fopen(path, "re");
+    if (file == nullptr) {
         return -1;
     }
 
+    LOG(INFO) << "Read lights mapping from " << path;
+    while (fgets(line, sizeof(line), file) != nullptr) {
+        char* comment = strchr(line, '#');
+        if (comment != nullptr) {
+            *comment = '\0';
+        }
+        int n = sscanf(line, "%31s %255s", typeName, device);
+        if (n <= 0) {
+            continue;
+        }
+        if ((n != 2) || (getLightType(typeName, &type) != 0)) {
+            LOG(ERROR) << "Invalid lights mapping line: " << line;
+            continue;
+        }
+        if (addMapping(mappings, type, device, leds, backlights, sHotplug) != 0) {
+            LOG(WARNING) << "No device " << device << " for light " << typeName;
+        }
+    }
+    fclose(file);
+
     return 0;
 }
 
 /**
- * Check if the backlight is available
- * @return true if available, false otherwise
+ * Build the light table, from the vendor mapping file if any, otherwise
+ * from the default mapping and led function names. Sysfs is scanned once.
+ * @param mappings = table to fill, in light id order
+ * @param missing = light types without device
  */
-bool LightsUtils::isBacklightAvailable()
+void LightsUtils::discoverLights(std::vector<LightsMapping>* mappings,
+                                 std::vector<LightType>* missing)
 {
-    int fd = 0;
-    fd = open(BACKLIGHT_BRIGHTNESS, O_RDONLY);
-    if (fd < 0) {
-        return false;
+    std::vector<std::string> leds;
+    std::vector<std::string> backlights;
+    std::vector<LightsMapping> found;
+
+    sKernelBlink = ::android::base::GetBoolProperty("ro.vendor.lights.kernel_blink", true);
+    sHotplug = ::android::base::GetBoolProperty("ro.vendor.lights.hotplug", false);
+    sLedCurve = LightsColorLut::parseCurve(
+            ::android::base::GetProperty("ro.vendor.lights.curve", "linear").c_str());
+
+    listDevices(LEDS_CLASS, &leds);
+    listDevices(BACKLIGHT_CLASS, &backlights);
+
+    std::string config = ::android::base::GetProperty("ro.vendor.lights.config",
+                                                      LIGHTS_CONFIG_DEFAULT);
+    if (readMappingFile(config.c_str(), &found, leds, backlights) != 0) {
+        for (auto& m : DEFAULT_MAPPING) {
+            addMapping(&found, m.type, m.device, leds, backlights);
+        }
+        for (auto& f : DEFAULT_FUNCTIONS) {
+            bool mapped = false;
+            for (auto& m : found) {
+                mapped |= (m.type == f.type);
+            }
+            if (mapped) {
+                continue;
+            }
+            /* backlight class devices have no function name, take the first one */
+            if ((f.type == LightType::BACKLIGHT) && !backlights.empty()) {
+                addMapping(&found, f.type, backlights[0].c_str(), leds, backlights);
+                continue;
+            }
+            for (auto& led : leds) {
+                const char* function = strrchr(led.c_str(), ':');
+                if ((function != nullptr) && (strcmp(function + 1, f.function) == 0)) {
+                    addMapping(&found, f.type, led.c_str(), leds, backlights);
+                }
+            }
+        }
+    }
+
+    /* keep the light type order for ids */
+    for (LightType type : LIGHT_TYPES) {
+        bool mapped = false;
+        for (auto& m : found) {
+            if (m.type == type) {
+                mappings->push_back(m);
+                mapped = true;
+            }
+        }
+        if (!mapped) {
+            missing->push_back(type);
+        }
+    }
+}
+
+/**
+ * Print sysfs statistics of the leds in use
+ * @param fd = output file descriptor
+ */
+void LightsUtils::dump(int fd)
+{
+    dprintf(fd, "Leds:\n");
+
+    pthread_mutex_lock(&sLedsMutex);
+    for (int i = 0; (i < MAX_LEDS) && (sLeds[i] != nullptr); i++) {
+        sLeds[i]->dump(fd);
     }
-    close(fd);
-    return true;
+    pthread_mutex_unlock(&sLedsMutex);
 }
 
 /**
  * Set the color value
  * 
+ * @param handle = led
  * @param color = RGB color value
+ * @param trigger = HW flash mode required ?
  * @return 0 if success, error code otherwise
  */
-int LightsUtils::setBacklightValue(int color)
+int LightsUtils::setColorValue(LightsLed* handle, int color, bool trigger)
 {
-    int fd = 0;
-    long int max_brightness = 1;
-    long int brightness = 0;
-    char buf[64] = {0};
-
-    /* get max backlight brightness */
-    // LOG(INFO) << "set color value " << std::hex << color << " for backlight";
-    fd = open(BACKLIGHT_MAX_BRIGHTNESS, O_RDONLY);
-    if (fd < 0) {
-        PLOG(ERROR) << "Failed to open max brightness for backlight";
-    }
+    long int brightness = handle->getBrightness(color);
 
-    /* max brightness size fixed to 8 bytes */
-    ssize_t rb = read(fd, buf, 8);
-    close(fd);
-    if (rb < 0) {
-        PLOG(ERROR) << "Failed to read max brightness for backlight";
-    } else {
-        char* endptr;
-        long int ret = strtol(buf, &endptr, 10);
-        if ('\0' != *endptr && '\n' != *endptr) {
-            LOG(ERROR) << "Failed to to convert max brightness string to int value";
-        } else {
-            max_brightness = ret;
-        }
+    LightsTrace::record(LightsTraceEvent::LED_COLOR, handle->getId(), brightness);
+
+    /* set led trigger */
+    handle->setTrigger(trigger ? LED_HW_TRIGGER_ON : LED_HW_TRIGGER_OFF);
+
+    /* set multicolor led channels */
+    if (handle->setColor(color) != 0) {
+        return -1;
     }
-    // LOG(INFO) << "Max brightness read: " << max_brightness;
-
-    /* calculate brightness depending on color level requested (RGB) */
-    color = color & 0x00FFFFFF;
-    if (color > 1) {
-        brightness = ((77*((color>>16)&0x00ff)) + (150*((color>>8)&0x00ff)) + (29*(color&0x00ff))) >> 8;
-        if (brightness > max_brightness)
-            brightness = max_brightness;
-    } else {
-        brightness = (color==1) ? max_brightness : 0;
+
+    /* set led brightness */
+    return handle->setBrightness(brightness);
+}
+
+/**
+ * Blink a led with a kernel trigger ("timer", else "pattern")
+ *
+ * @param handle = led
+ * @param color = RGB color value of the on phase
+ * @param onMs = on phase duration
+ * @param offMs = off phase duration
+ * @return backend used, LightsBackend::NONE if the kernel cannot blink the led
+ */
+LightsBackend LightsUtils::setKernelFlashValue(LightsLed* handle, int color, int onMs, int offMs)
+{
+    if (!sKernelBlink || (onMs <= 0) || (offMs <= 0)) {
+        return LightsBackend::NONE;
     }
-    // LOG(INFO) << "Brightness set: " << brightness;
 
-    /* set backlight brightness */
-    fd = open(BACKLIGHT_BRIGHTNESS, O_RDWR);
-    if (fd < 0) {
-        PLOG(ERROR) << "Failed to open backlight brightness";
-        return -1;
+    /* brightness 0 would remove the trigger */
+    long int brightness = handle->getBrightness(color);
+    if ((brightness == 0) || (handle->setColor(color) != 0)) {
+        return LightsBackend::NONE;
     }
 
-    int size_w = snprintf(buf, 64, "%d", (int)brightness);
-    ssize_t wb = write(fd, &buf, size_w*sizeof(char));
-    close(fd);
-    if (wb == -1) {
-        PLOG(ERROR) << "Failed to write backlight brightness";
-        return -1;
+    LightsBackend backend = LightsBackend::NONE;
+    if (handle->supportsTrigger(LightsLed::TRIGGER_TIMER) &&
+        (handle->setTimerBlink(brightness, onMs, offMs) == 0)) {
+        backend = LightsBackend::KERNEL_TIMER;
+    } else if (handle->supportsTrigger(LightsLed::TRIGGER_PATTERN) &&
+        (handle->setPatternBlink(brightness, onMs, offMs) == 0)) {
+        backend = LightsBackend::KERNEL_PATTERN;
     }
 
-    return 0;
+    LightsTrace::record(LightsTraceEvent::LED_KERNEL_FLASH, handle->getId(),
+                        static_cast<uint32_t>(backend));
+    return backend;
 }
 
 /**
- * Get back light type name for trace purpose
- * @param type = light type
- * @return name
+ * Set the color value
+ * 
+ * @param handle = backlight
+ * @param color = RGB color value
+ * @return 0 if success, error code otherwise
  */
-const char* LightsUtils::getLightTypeName(LightType type)
+int LightsUtils::setBacklightValue(LightsLed* handle, int color)
 {
-    char* ch = new char[16];
-    switch (type) {
-        case LightType::BACKLIGHT:
-            strcpy(ch, "BACKLIGHT");
-            break;
-        case LightType::KEYBOARD:
-            strcpy(ch, "KEYBOARD");
-            break;
-        case LightType::BUTTONS:
-            strcpy(ch, "BUTTONS");
-            break;
-        case LightType::BATTERY:
-            strcpy(ch, "BATTERY");
-            break;
-        case LightType::NOTIFICATIONS:
-            strcpy(ch, "NOTIFICATIONS");
-            break;
-        case LightType::ATTENTION:
-            strcpy(ch, "ATTENTION");
-            break;
-        case LightType::BLUETOOTH:
-            strcpy(ch, "BLUETOOTH");
-            break;
-        case LightType::WIFI:
-            strcpy(ch, "WIFI");
-            break;
-        case LightType::MICROPHONE:
-            strcpy(ch, "MICROPHONE");
-            break;
-        default:
-            strcpy(ch, "UNKNOWN");
-    }
-    return ch;
+    long int brightness = handle->getBrightness(color);
+
+    LightsTrace::record(LightsTraceEvent::LED_BACKLIGHT, handle->getId(), brightness);
+
+    /* set backlight brightness */
+    return handle->setBrightness(brightness);
 }
 
 /**
- * Get back flash mode name for trace purpose
- * @param mode = flash mode
- * @return name
+ * Tell if blinking may be offloaded to kernel triggers
+ * @return ro.vendor.lights.kernel_blink value
  */
-const char* LightsUtils::getFlashModeName(FlashMode mode)
+bool LightsUtils::isKernelBlinkEnabled()
 {
-    char* ch = new char[16];
-    switch (mode) {
-        case FlashMode::NONE:
-            strcpy(ch, "NONE");
-            break;
-        case FlashMode::TIMED:
-            strcpy(ch, "TIMED");
-            break;
-        case FlashMode::HARDWARE:
-            strcpy(ch, "HARDWARE");
-            break;
-        default:
-            strcpy(ch, "UNKNOWN");
+    return sKernelBlink;
+}
+
+/**
+ * Tell if devices may come and go
+ * @return ro.vendor.lights.hotplug value
+ */
+bool LightsUtils::isHotplugEnabled()
+{
+    return sHotplug;
+}
+
+/**
+ * Move to a color through a brightness transition
+ *
+ * @param ramp = transition of the device
+ * @param handle = led or backlight
+ * @param color = RGB color value
+ * @param durationMs = transition duration
+ * @return 0 if success, error code otherwise
+ */
+int LightsUtils::setRampValue(LightsRamp* ramp, LightsLed* handle, int color, int durationMs)
+{
+    long int brightness = handle->getBrightness(color);
+
+    LightsTrace::record(LightsTraceEvent::LED_RAMP, handle->getId(), brightness);
+
+    /* a trigger would fight the transition */
+    handle->setTrigger(LED_HW_TRIGGER_OFF);
+
+    /* set multicolor led channels, the transition is on the brightness */
+    if (handle->setColor(color) != 0) {
+        return -1;
     }
-    return ch;
+
+    return ramp->rampTo(brightness, durationMs);
 }
 
 }  // namespace light
@@ -16,6 +16,12 @@
 
 #pragma once
 
+#include "LightsLed.h"
+#include "LightsRamp.h"
+
+#include <stddef.h>
+#include <vector>
+
 #include <aidl/android/hardware/light/BnLights.h>
 
 namespace aidl {
@@ -27,16 +33,72 @@ using ::ndk::ScopedAStatus;
 using ::aidl::android::hardware::light::LightType;
 using ::aidl::android::hardware::light::FlashMode;
 
+/**
+ * How the output of a light is produced
+ */
+enum class LightsBackend {
+    NONE,           // not driven
+    STEADY,         // brightness write, no flash
+    HEARTBEAT,      // kernel heartbeat trigger (HARDWARE flash fallback)
+    KERNEL_TIMER,   // kernel timer trigger with requested delays
+    KERNEL_PATTERN, // kernel pattern trigger with requested delays
+    USERSPACE,      // LightsFlash edges from the scheduler thread
+    RAMP,           // LightsRamp transition from the scheduler thread
+};
+
+/**
+ * Physical device backing a light
+ */
+struct LightsMapping {
+    LightType type;
+    int ordinal;
+    LightsLed* led;
+};
+
 class LightsUtils {
 	private:
 		LightsUtils() {}	// forbid instance creation
+
+		/* names for trace purpose, indexed by enum value */
+		static constexpr const char* LIGHT_TYPE_NAMES[] = {
+			"BACKLIGHT", "KEYBOARD", "BUTTONS", "BATTERY", "NOTIFICATIONS",
+			"ATTENTION", "BLUETOOTH", "WIFI", "MICROPHONE",
+		};
+		static constexpr const char* FLASH_MODE_NAMES[] = {
+			"NONE", "TIMED", "HARDWARE",
+		};
+		static constexpr const char* BACKEND_NAMES[] = {
+			"none", "steady", "kernel-heartbeat", "kernel-timer", "kernel-pattern", "userspace",
+			"ramp",
+		};
+
+		template <size_t N>
+		static constexpr const char* getName(const char* const (&names)[N], int index) {
+			return ((index >= 0) && (index < (int)N)) ? names[index] : "UNKNOWN";
+		}
 	public:
-		static const char* getLedName(LightType type);
-		static int setColorValue(const char* led, int color, bool trigger);
-		static bool isBacklightAvailable();
-		static int setBacklightValue(int color);
-		static const char* getFlashModeName(FlashMode mode);
-		static const char* getLightTypeName(LightType type);
+		static void setSysfsRoot(const char* root);
+		static const char* getSysfsRoot();
+		static LightsLed* getLed(const char* device, bool backlight);
+		static LightsLed* findLed(const char* device);
+		static void discoverLights(std::vector<LightsMapping>* mappings,
+		                           std::vector<LightType>* missing);
+		static int setColorValue(LightsLed* led, int color, bool trigger);
+		static LightsBackend setKernelFlashValue(LightsLed* led, int color, int onMs, int offMs);
+		static int setBacklightValue(LightsLed* led, int color);
+		static int setRampValue(LightsRamp* ramp, LightsLed* led, int color, int durationMs);
+		static bool isKernelBlinkEnabled();
+		static bool isHotplugEnabled();
+		static constexpr const char* getFlashModeName(FlashMode mode) {
+			return getName(FLASH_MODE_NAMES, static_cast<int>(mode));
+		}
+		static constexpr const char* getLightTypeName(LightType type) {
+			return getName(LIGHT_TYPE_NAMES, static_cast<int>(type));
+		}
+		static constexpr const char* getBackendName(LightsBackend backend) {
+			return getName(BACKEND_NAMES, static_cast<int>(backend));
+		}
+		static void dump(int fd);
 };
 
 }  // namespace light
@@ -0,0 +1,785 @@
+/*
+ * Copyright (C) 2024 STMicroelectronics
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Lights service benchmark, run against a fake sysfs tree.
+ *
+ * usage: lights_benchmark [-d <tmp dir>] [-n <iterations>] [-t <threads>] [-k] [-v] [-T]
+ *                         [-w <seconds>] [-P <policy>[:<priority>]] [-C <cpus>] [-S <stack kB>] [-M]
+ *   -d: directory where the fake sysfs tree is created
+ *   -n: number of setLightState calls per light and flash mode
+ *   -t: maximum number of concurrent clients
+ *   -k: fake leds list the kernel "timer" and "pattern" triggers
+ *   -v: keep the service logs
+ *   -T: print the event trace in the final dump (see tools/lights_trace.py)
+ *   -w: only measure the scheduler wakeup latency, idle then under load, for
+ *       this long each
+ *   -P, -C, -S, -M: scheduler thread policy and priority, CPUs, stack size
+ *       and memory locking, instead of the ro.vendor.lights.sched.* properties
+ *
+ * It only measures: the functional checks are in lights_check.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <limits.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+
+#include "Lights.h"
+#include "LightsFakeSysfs.h"
+#include "LightsTrace.h"
+
+#include <android-base/logging.h>
+
+using ::aidl::android::hardware::light::FlashMode;
+using ::aidl::android::hardware::light::HwLight;
+using ::aidl::android::hardware::light::HwLightConfig;
+using ::aidl::android::hardware::light::HwLightState;
+using ::aidl::android::hardware::light::LightType;
+using ::aidl::android::hardware::light::LightsColorLut;
+using ::aidl::android::hardware::light::LightsCurve;
+using ::aidl::android::hardware::light::LightsHistogram;
+using ::aidl::android::hardware::light::LightsScheduler;
+using ::aidl::android::hardware::light::LightsSchedulerTask;
+using ::aidl::android::hardware::light::LightsTrace;
+using ::aidl::android::hardware::light::LightsTraceEvent;
+using ::aidl::android::hardware::light::Lights;
+using ::aidl::android::hardware::light::LightsUpdate;
+using ::aidl::android::hardware::light::LightsUtils;
+
+#ifdef __ANDROID__
+static char const* const TMP_DIR_DEFAULT = "/data/local/tmp";
+#else
+static char const* const TMP_DIR_DEFAULT = "/tmp";
+#endif
+
+
+static int64_t const ONE_MS_IN_NS = 1000000LL;
+static int64_t const ONE_S_IN_NS = 1000000000LL;
+
+static int64_t now() {
+    struct timespec ts = {0, 0};
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ONE_S_IN_NS * ts.tv_sec + ts.tv_nsec;
+}
+
+static int64_t percentile(std::vector<int64_t>& samples, int pct) {
+    if (samples.empty()) {
+        return 0;
+    }
+    size_t index = (samples.size() - 1) * pct / 100;
+    std::nth_element(samples.begin(), samples.begin() + index, samples.end());
+    return samples[index];
+}
+
+/**
+ * Measure setLightState latency and throughput
+ * @param lights = service instance
+ * @param light = light to update
+ * @param mode = flash mode requested
+ * @param iterations = number of calls
+ */
+static void benchSetLightState(Lights* lights, const HwLight& light, FlashMode mode,
+                               int iterations) {
+    std::vector<int64_t> samples;
+    HwLightState state;
+    int errors = 0;
+
+    samples.reserve(iterations);
+    state.flashMode = mode;
+    state.flashOnMs = 500;
+    state.flashOffMs = 500;
+
+    int64_t start = now();
+    for (int i = 0; i < iterations; i++) {
+        /* change the color on every call so that each one reaches sysfs */
+        state.color = 0xff000000 | (((i % 255) + 1) * 0x010101);
+        int64_t t0 = now();
+        if (!lights->setLightState(light.id, state).isOk()) {
+            errors++;
+        }
+        samples.push_back(now() - t0);
+    }
+    int64_t total = now() - start;
+
+    int64_t p50 = percentile(samples, 50);
+    int64_t p99 = percentile(samples, 99);
+    printf("%-14s %-9s %8lld %8lld %12.0f %6d\n",
+           LightsUtils::getLightTypeName(light.type), LightsUtils::getFlashModeName(mode),
+           (long long)(p50 / 1000), (long long)(p99 / 1000),
+           (total > 0) ? (double)iterations * ONE_S_IN_NS / total : 0.0, errors);
+
+    /* leave the light off for the next run */
+    state.color = 0;
+    state.flashMode = FlashMode::NONE;
+    lights->setLightState(light.id, state);
+}
+
+/**
+ * Measure setLightState throughput with concurrent clients, each one
+ * updating its own light
+ * @param lights = service instance
+ * @param hwLights = lights to update, client i uses light i modulo size
+ * @param clients = number of concurrent clients
+ * @param iterations = number of calls per client
+ */
+static void benchConcurrency(Lights* lights, const std::vector<HwLight>& hwLights, int clients,
+                             int iterations) {
+    std::vector<std::thread> threads;
+
+    int64_t start = now();
+    for (int c = 0; c < clients; c++) {
+        threads.emplace_back([lights, &hwLights, c, iterations] {
+            const HwLight& light = hwLights[c % hwLights.size()];
+            HwLightState state;
+            for (int i = 0; i < iterations; i++) {
+                state.color = 0xff000000 | (((i % 255) + 1) * 0x010101);
+                lights->setLightState(light.id, state);
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    int64_t total = now() - start;
+
+    /* leave the lights off, a lit light would mask the next runs */
+    HwLightState off;
+    for (const HwLight& light : hwLights) {
+        lights->setLightState(light.id, off);
+    }
+
+    printf("%7d %12.0f\n", clients,
+           (total > 0) ? (double)clients * iterations * ONE_S_IN_NS / total : 0.0);
+}
+
+/* per-thread counters, packed as in an array of small structs, or one
+   cache line each as the light table slots */
+struct PackedCounters {
+    std::atomic<uint64_t> calls{0};
+    std::atomic<int64_t> sumNs{0};
+};
+
+struct alignas(LIGHTS_CACHE_LINE_SIZE) AlignedCounters {
+    std::atomic<uint64_t> calls{0};
+    std::atomic<int64_t> sumNs{0};
+};
+
+/**
+ * Measure the update rate of per-thread counters, each thread its own
+ * @param counters = one slot per thread
+ * @param threads = number of threads
+ * @param iterations = updates per thread
+ * @return updates per second, all threads
+ */
+template <typename T>
+static double benchCounters(T* counters, int threads, int iterations) {
+    std::vector<std::thread> workers;
+
+    int64_t start = now();
+    for (int t = 0; t < threads; t++) {
+        workers.emplace_back([counters, t, iterations] {
+            for (int i = 0; i < iterations; i++) {
+                counters[t].calls.fetch_add(1, std::memory_order_relaxed);
+                counters[t].sumNs.fetch_add(i, std::memory_order_relaxed);
+            }
+        });
+    }
+    for (auto& w : workers) {
+        w.join();
+    }
+    int64_t total = now() - start;
+
+    return (total > 0) ? (double)threads * iterations * ONE_S_IN_NS / total : 0.0;
+}
+
+/**
+ * Compare threads updating their own counters packed together, and on
+ * distinct cache lines, as the light table slots
+ * @param maxThreads = maximum number of threads
+ * @param iterations = updates per thread
+ */
+static void benchFalseSharing(int maxThreads, int iterations) {
+    std::vector<PackedCounters> packed(maxThreads);
+    std::vector<AlignedCounters> aligned(maxThreads);
+
+    printf("light slot: %zu bytes, %zu cache lines of %d bytes\n", sizeof(HwLightConfig),
+           sizeof(HwLightConfig) / LIGHTS_CACHE_LINE_SIZE, LIGHTS_CACHE_LINE_SIZE);
+    printf("%7s %14s %14s %7s\n", "threads", "packed/s", "aligned/s", "ratio");
+    for (int threads = 1; threads <= maxThreads; threads *= 2) {
+        double packedRate = benchCounters(packed.data(), threads, iterations);
+        double alignedRate = benchCounters(aligned.data(), threads, iterations);
+        printf("%7d %14.0f %14.0f %7.2f\n", threads, packedRate, alignedRate,
+               (packedRate > 0) ? alignedRate / packedRate : 0.0);
+    }
+}
+
+/**
+ * Compare updating several lights one call each with a single batch
+ * @param lights = service instance
+ * @param hwLights = lights to update together, backlight excluded
+ * @param iterations = number of rounds
+ */
+static void benchBatch(Lights* lights, const std::vector<HwLight>& hwLights, int iterations) {
+    LightsUpdate updates[Lights::MAX_BATCH];
+    int nbUpdates = 0;
+
+    for (const HwLight& light : hwLights) {
+        if ((light.type != LightType::BACKLIGHT) && (nbUpdates < Lights::MAX_BATCH)) {
+            updates[nbUpdates].id = light.id;
+            updates[nbUpdates].state = HwLightState();
+            nbUpdates++;
+        }
+    }
+
+    int64_t start = now();
+    for (int i = 0; i < iterations; i++) {
+        for (int u = 0; u < nbUpdates; u++) {
+            updates[u].state.color = 0xff000000 | (((i % 255) + 1) * 0x010101);
+            lights->setLightState(updates[u].id, updates[u].state);
+        }
+    }
+    int64_t single = now() - start;
+
+    int errors = 0;
+    start = now();
+    for (int i = 0; i < iterations; i++) {
+        for (int u = 0; u < nbUpdates; u++) {
+            updates[u].state.color = 0xff000000 | (((i % 255) + 1) * 0x010101);
+        }
+        errors += (lights->setLightStates(updates, nbUpdates) != 0);
+    }
+    int64_t batched = now() - start;
+
+    for (int u = 0; u < nbUpdates; u++) {
+        updates[u].state.color = 0;
+    }
+    lights->setLightStates(updates, nbUpdates);
+    lights->flush();
+
+    printf("%d lights: one call each=%.2fus batch=%.2fus errors=%d\n", nbUpdates,
+           (double)single / iterations / 1000, (double)batched / iterations / 1000, errors);
+}
+
+/**
+ * Measure the timing error of userspace flash edges, as seen on the fake
+ * brightness node
+ * @param lights = service instance
+ * @param light = light to flash
+ * @param root = fake sysfs root
+ * @param periodMs = on and off phase duration
+ * @param durationMs = measurement duration
+ */
+static void benchFlashEdges(Lights* lights, const HwLight& light, const char* root,
+                            int periodMs, int durationMs) {
+    std::vector<int64_t> edges;
+    std::vector<int64_t> errors;
+    HwLightState state;
+
+    int fd = watchNode(root, FAKE_LED, "brightness");
+    if (fd < 0) {
+        return;
+    }
+
+    state.color = 0xffffffff;
+    state.flashMode = FlashMode::TIMED;
+    state.flashOnMs = periodMs;
+    state.flashOffMs = periodMs;
+    lights->setLightState(light.id, state);
+
+    countWrites(fd, durationMs, &edges);
+    close(fd);
+
+    state.color = 0;
+    state.flashMode = FlashMode::NONE;
+    lights->setLightState(light.id, state);
+
+    /* expected edge k at first edge + k * period */
+    for (size_t i = 0; i < edges.size(); i++) {
+        int64_t expected = edges[0] + (int64_t)i * periodMs * ONE_MS_IN_NS;
+        errors.push_back(llabs(edges[i] - expected));
+    }
+    int64_t max = errors.empty() ? 0 : *std::max_element(errors.begin(), errors.end());
+
+    printf("%-14s %-9s edges=%zu (expected %d) error p50=%lldus p99=%lldus max=%lldus\n",
+           LightsUtils::getLightTypeName(light.type), "TIMED", edges.size(),
+           durationMs / periodMs, (long long)(percentile(errors, 50) / 1000),
+           (long long)(percentile(errors, 99) / 1000), (long long)(max / 1000));
+}
+
+/**
+ * Measure the latency of retiming a light flashing many times faster
+ * than its period, then of stopping it: both transitions must not wait
+ * for the scheduler thread
+ * @param lights = service instance
+ * @param light = light to flash
+ */
+static void benchFlashRetime(Lights* lights, const HwLight& light) {
+    std::vector<int64_t> retimes;
+    std::vector<int64_t> stops;
+    HwLightState state;
+
+    state.flashMode = FlashMode::TIMED;
+    state.color = 0xffffffff;
+    state.flashOnMs = 50;
+    state.flashOffMs = 50;
+    lights->setLightState(light.id, state);
+    usleep(120000);
+
+    /* one retime every 5ms, delays alternating 40ms and 60ms */
+    int64_t end = now() + 300 * ONE_MS_IN_NS;
+    for (int i = 0; now() < end; i++) {
+        state.color = (i & 1) ? 0xff808080 : 0xffffffff;
+        state.flashOnMs = (i & 1) ? 60 : 40;
+        state.flashOffMs = (i & 1) ? 40 : 60;
+        int64_t t0 = now();
+        lights->setLightState(light.id, state);
+        retimes.push_back(now() - t0);
+        usleep(5000);
+    }
+
+    /* TIMED -> NONE, the flash running */
+    for (int i = 0; i < 50; i++) {
+        state.flashMode = FlashMode::TIMED;
+        state.color = 0xffffffff;
+        lights->setLightState(light.id, state);
+        usleep(2000);
+        state.flashMode = FlashMode::NONE;
+        state.color = 0;
+        int64_t t0 = now();
+        lights->setLightState(light.id, state);
+        stops.push_back(now() - t0);
+    }
+
+    printf("%-14s %zu retimes: latency p50=%lldus p99=%lldus\n",
+           LightsUtils::getLightTypeName(light.type), retimes.size(),
+           (long long)(percentile(retimes, 50) / 1000),
+           (long long)(percentile(retimes, 99) / 1000));
+    printf("%-14s %zu stops: latency p50=%lldus p99=%lldus\n",
+           LightsUtils::getLightTypeName(light.type), stops.size(),
+           (long long)(percentile(stops, 50) / 1000), (long long)(percentile(stops, 99) / 1000));
+}
+
+/**
+ * Time the recording of a trace event
+ * @param iterations = number of events
+ * @return average cost in nanoseconds
+ */
+static double benchTrace(int iterations) {
+    int64_t start = now();
+    for (int i = 0; i < iterations; i++) {
+        LightsTrace::record(LightsTraceEvent::SET_LIGHT_STATE, 0, i);
+    }
+    return (double)(now() - start) / iterations;
+}
+
+/**
+ * Measure the scheduler wakeups while several lights flash with close
+ * periods
+ * @param lights = service
+ * @param hwLights = lights to flash, one period each
+ * @param slackMs = timer slack
+ * @param durationMs = measurement duration
+ */
+static void benchCoalescing(Lights* lights, const std::vector<HwLight>& hwLights, int slackMs,
+                            int durationMs) {
+    LightsScheduler* scheduler = LightsScheduler::getInstance();
+    HwLightState state;
+    int periodMs = 100;
+    double edges = 0;
+
+    scheduler->setSlack(slackMs * ONE_MS_IN_NS);
+    state.color = 0xffffffff;
+    state.flashMode = FlashMode::TIMED;
+    for (const HwLight& light : hwLights) {
+        state.flashOnMs = periodMs;
+        state.flashOffMs = periodMs;
+        lights->setLightState(light.id, state);
+        edges += 2.0 * ONE_S_IN_NS / (2 * periodMs * ONE_MS_IN_NS);
+        periodMs += 7;
+    }
+
+    uint64_t wakeups = scheduler->getWakeups();
+    usleep(durationMs * 1000);
+    wakeups = scheduler->getWakeups() - wakeups;
+
+    state.color = 0;
+    state.flashMode = FlashMode::NONE;
+    for (const HwLight& light : hwLights) {
+        lights->setLightState(light.id, state);
+    }
+    scheduler->setSlack(0);
+
+    printf("%8d %12.1f %12.1f\n", slackMs, wakeups * 1000.0 / durationMs, edges);
+}
+
+/**
+ * Time the color to brightness table lookups
+ * @param iterations = number of lookups per table
+ */
+static void benchColorLut(int iterations) {
+    LightsColorLut lut;
+
+    printf("%-11s %8s %10s\n", "curve", "max", "ns/lookup");
+    for (LightsCurve curve : {LightsCurve::LINEAR, LightsCurve::GAMMA, LightsCurve::PERCEPTUAL}) {
+        for (long int max : {1L, 255L, 1023L, 4095L}) {
+            lut.build(curve, max);
+
+            volatile long int sink = 0;
+            int64_t start = now();
+            for (int i = 0; i < iterations; i++) {
+                sink = sink + lut.getBrightness(i * 0x010101);
+            }
+            int64_t elapsed = now() - start;
+
+            printf("%-11s %8ld %10.1f\n", LightsColorLut::getCurveName(curve), max,
+                   (double)elapsed / iterations);
+        }
+    }
+}
+
+/* periodic scheduler task measuring how late it runs */
+class WakeupProbe : public LightsSchedulerTask {
+    public:
+        int64_t mPeriod;
+        int64_t mNext = 0;
+        LightsHistogram mLatency;
+
+        explicit WakeupProbe(int64_t period) : mPeriod{period} {}
+        int64_t onDeadline(int64_t now) override {
+            mLatency.record(now - mNext);
+            do {
+                mNext += mPeriod;
+            } while (mNext <= now);
+            return mNext;
+        }
+};
+
+/* one-shot scheduler task: the scheduler runs its tasks one at a time,
+   so once it has run, any callback started before it has returned */
+class SchedulerBarrier : public LightsSchedulerTask {
+    private:
+        pthread_mutex_t mMutex = PTHREAD_MUTEX_INITIALIZER;
+        pthread_cond_t mCond = PTHREAD_COND_INITIALIZER;
+        bool mDone = false;
+    public:
+        int64_t onDeadline(int64_t) override {
+            pthread_mutex_lock(&mMutex);
+            mDone = true;
+            pthread_cond_signal(&mCond);
+            pthread_mutex_unlock(&mMutex);
+            return -1;
+        }
+
+        /**
+         * Wait for the callbacks running or due on the scheduler thread
+         * @param scheduler = scheduler instance
+         * @return 0 if success, error code otherwise
+         */
+        int wait(LightsScheduler* scheduler) {
+            mDone = false;
+            if (scheduler->schedule(this, now()) != 0) {
+                return -1;
+            }
+            pthread_mutex_lock(&mMutex);
+            while (!mDone) {
+                pthread_cond_wait(&mCond, &mMutex);
+            }
+            pthread_mutex_unlock(&mMutex);
+            return 0;
+        }
+};
+
+/**
+ * Synthetic load: spin, and with memory churn fault in and release a
+ * buffer, until stopped
+ * @param stop = stop flag
+ * @param memory = churn memory too
+ */
+static void runLoad(const std::atomic<bool>* stop, bool memory) {
+    size_t const size = 4 * 1024 * 1024;
+    volatile uint64_t sink = 0;
+
+    while (!stop->load(std::memory_order_relaxed)) {
+        for (int i = 0; i < 100000; i++) {
+            sink = sink + i;
+        }
+        if (memory) {
+            void* buf = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS,
+                             -1, 0);
+            if (buf != MAP_FAILED) {
+                memset(buf, 1, size);
+                munmap(buf, size);
+            }
+        }
+    }
+}
+
+/**
+ * Measure the delay from a 2ms period deadline to the scheduler callback,
+ * idle, then with one spinning thread per CPU, then with memory churn
+ * @param seconds = duration of each phase
+ * @return 0 if success, error code otherwise
+ */
+static int benchWakeup(int seconds) {
+    LightsScheduler* scheduler = LightsScheduler::getInstance();
+    WakeupProbe probe(2 * ONE_MS_IN_NS);
+    SchedulerBarrier barrier;
+    int cpus = std::max(1L, sysconf(_SC_NPROCESSORS_ONLN));
+
+    scheduler->setSlack(0);
+    printf("%-16s %8s %8s %8s %9s %8s\n", "load", "wakeups", "p50<us", "p99<us", "p99.9<us",
+           "max(us)");
+    for (int phase = 0; phase < 3; phase++) {
+        std::atomic<bool> stop{false};
+        std::vector<std::thread> threads;
+
+        for (int i = 0; (phase > 0) && (i < cpus); i++) {
+            threads.emplace_back(runLoad, &stop, phase == 2);
+        }
+        probe.mLatency.reset();
+        probe.mNext = now() + probe.mPeriod;
+        if (scheduler->schedule(&probe, probe.mNext) != 0) {
+            fprintf(stderr, "cannot start the scheduler\n");
+            stop = true;
+            for (auto& t : threads) {
+                t.join();
+            }
+            return -1;
+        }
+        usleep(seconds * 1000000LL);
+        /* cancel does not wait for a running callback: the barrier does,
+           the probe is not touched by the scheduler thread afterwards */
+        scheduler->cancel(&probe);
+        bool idle = (barrier.wait(scheduler) == 0);
+        stop = true;
+        for (auto& t : threads) {
+            t.join();
+        }
+        if (!idle) {
+            fprintf(stderr, "cannot wait for the scheduler\n");
+            return -1;
+        }
+
+        const char* names[] = {"idle", "cpu", "cpu+memory"};
+        char name[32];
+        snprintf(name, sizeof(name), "%s x%d", names[phase], (phase > 0) ? cpus : 0);
+        printf("%-16s %8llu %8lld %8lld %9lld %8lld\n", (phase > 0) ? name : names[0],
+               (unsigned long long)probe.mLatency.getCount(),
+               (long long)probe.mLatency.getPercentileUs(50),
+               (long long)probe.mLatency.getPercentileUs(99),
+               (long long)probe.mLatency.getPercentileUs(99.9),
+               (long long)(probe.mLatency.getMaxNs() / 1000));
+    }
+
+    printf("\n");
+    fflush(stdout);
+    scheduler->dump(STDOUT_FILENO);
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    const char* tmpDir = TMP_DIR_DEFAULT;
+    int iterations = 10000;
+    int maxClients = 4;
+    bool kernelBlink = false;
+    bool verbose = false;
+    bool trace = false;
+    int wakeupSeconds = 0;
+    const char* policy = nullptr;
+    int priority = 1;
+    const char* cpus = "";
+    int stackKb = 0;
+    bool lockMemory = false;
+    char root[PATH_MAX];
+    char* sep;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "d:n:t:kvTw:P:C:S:M")) != -1) {
+        switch (opt) {
+            case 'w':
+                wakeupSeconds = atoi(optarg);
+                break;
+            case 'P':
+                policy = optarg;
+                sep = strchr(optarg, ':');
+                if (sep != nullptr) {
+                    *sep = '\0';
+                    priority = atoi(sep + 1);
+                }
+                break;
+            case 'C':
+                cpus = optarg;
+                break;
+            case 'S':
+                stackKb = atoi(optarg);
+                break;
+            case 'M':
+                lockMemory = true;
+                break;
+            case 'd':
+                tmpDir = optarg;
+                break;
+            case 'n':
+                iterations = atoi(optarg);
+                break;
+            case 't':
+                maxClients = atoi(optarg);
+                break;
+            case 'k':
+                kernelBlink = true;
+                break;
+            case 'T':
+                trace = true;
+                break;
+            case 'v':
+                verbose = true;
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-d <tmp dir>] [-n <iterations>] [-t <threads>] [-k] [-v] [-T]"
+                        " [-w <seconds>] [-P <policy>[:<priority>]] [-C <cpus>] [-S <stack kB>] [-M]\n", argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+
+    if (!verbose) {
+        ::android::base::SetMinimumLogSeverity(::android::base::WARNING);
+    }
+
+    if (((policy != nullptr) || (cpus[0] != '\0') || (stackKb != 0) || lockMemory) &&
+        (LightsScheduler::getInstance()->configure((policy != nullptr) ? policy : "other",
+                                                   priority, cpus, stackKb, lockMemory) != 0)) {
+        fprintf(stderr, "invalid scheduler settings\n");
+        return EXIT_FAILURE;
+    }
+    if (wakeupSeconds > 0) {
+        return (benchWakeup(wakeupSeconds) == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    snprintf(root, sizeof(root), "%s/lights-bench-XXXXXX", tmpDir);
+    if ((mkdtemp(root) == nullptr) || (createFakeSysfs(root, kernelBlink) != 0)) {
+        fprintf(stderr, "cannot create fake sysfs in %s\n", tmpDir);
+        return EXIT_FAILURE;
+    }
+    LightsUtils::setSysfsRoot(root);
+
+    /* same steps as the service main() */
+    int64_t start = now();
+    std::shared_ptr<Lights> lights = ndk::SharedRefBase::make<Lights>();
+    int64_t constructed = now();
+    lights->setRegisterTime(constructed - start);
+    lights->warmUp();
+    printf("startup: discovery and probe=%lldus warm-up=%lldus\n\n",
+           (long long)((constructed - start) / 1000), (long long)((now() - constructed) / 1000));
+
+    std::vector<HwLight> hwLights;
+    lights->getLights(&hwLights);
+
+    printf("%-14s %-9s %8s %8s %12s %6s\n", "light", "flash", "p50(us)", "p99(us)",
+           "calls/s", "errors");
+    for (const HwLight& light : hwLights) {
+        for (FlashMode mode : {FlashMode::NONE, FlashMode::HARDWARE, FlashMode::TIMED}) {
+            benchSetLightState(lights.get(), light, mode, iterations);
+        }
+    }
+
+    /* one light per device, so that clients do not share a device lock */
+    std::vector<HwLight> independentLights;
+    std::vector<HwLight> sharedLights;
+    for (const HwLight& light : hwLights) {
+        if ((light.type == LightType::NOTIFICATIONS) || (light.type == LightType::ATTENTION)) {
+            sharedLights.push_back(light);
+        }
+        if (light.type != LightType::ATTENTION) {
+            independentLights.push_back(light);
+        }
+    }
+    printf("\nconcurrent clients, distinct devices (%zu):\n%7s %12s\n",
+           independentLights.size(), "clients", "calls/s");
+    for (int clients = 1; clients <= maxClients; clients *= 2) {
+        benchConcurrency(lights.get(), independentLights, clients, iterations);
+    }
+    printf("\nconcurrent clients, lights sharing one device:\n%7s %12s\n", "clients", "calls/s");
+    for (int clients = 1; clients <= maxClients; clients *= 2) {
+        benchConcurrency(lights.get(), sharedLights, clients, iterations);
+    }
+
+    printf("\nfalse sharing, per-thread counters:\n");
+    benchFalseSharing(std::max(maxClients, 2), iterations * 100);
+
+    printf("\nbatched updates:\n");
+    benchBatch(lights.get(), hwLights, iterations);
+
+    printf("\nflash edge timing error:\n");
+    for (const HwLight& light : hwLights) {
+        if (kernelBlink) {
+            printf("offloaded to the kernel timer trigger, no userspace edge\n");
+            break;
+        }
+        if (light.type == LightType::NOTIFICATIONS) {
+            benchFlashEdges(lights.get(), light, root, 50, 2000);
+        }
+    }
+
+    printf("\nflash retiming and stop:\n");
+    for (const HwLight& light : hwLights) {
+        if (kernelBlink) {
+            printf("offloaded to the kernel timer trigger\n");
+            break;
+        }
+        if (light.type == LightType::NOTIFICATIONS) {
+            benchFlashRetime(lights.get(), light);
+        }
+    }
+
+    printf("\ncolor conversion:\n");
+    benchColorLut(iterations);
+
+    printf("\ntrace record: %.1fns\n", benchTrace(iterations));
+
+    if (!kernelBlink) {
+        std::vector<HwLight> flashing;
+        for (const HwLight& light : hwLights) {
+            if ((light.type == LightType::KEYBOARD) || (light.type == LightType::BATTERY) ||
+                (light.type == LightType::WIFI)) {
+                flashing.push_back(light);
+            }
+        }
+        printf("\nwakeup coalescing, %zu lights flashing:\n%8s %12s %12s\n", flashing.size(),
+               "slack ms", "wakeups/s", "edges/s");
+        for (int slackMs : {0, 5, 20}) {
+            benchCoalescing(lights.get(), flashing, slackMs, 2000);
+        }
+    }
+
+    printf("\n");
+    fflush(stdout);
+    const char* dumpArgs[] = { "--flush", "--trace" };
+    lights->dump(STDOUT_FILENO, dumpArgs, trace ? 2 : 1);
+
+    removeFakeSysfs(root);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,703 @@
+/*
+ * Copyright (C) 2024 STMicroelectronics
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Lights service checks, run against a fake sysfs tree.
+ *
+ * usage: lights_check [-d <tmp dir>] [-k] [-v]
+ *   -d: directory where the fake sysfs tree is created
+ *   -k: fake leds list the kernel "timer" and "pattern" triggers
+ *   -v: keep the service logs
+ *
+ * Each check prints its outcome, followed by FAILED when it does not
+ * hold. It fails if any check fails, among them if setLightState
+ * allocates heap memory (C++ allocations of the calling thread are
+ * counted).
+ */
+
+#include <atomic>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <new>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+
+#include "Lights.h"
+#include "LightsFakeSysfs.h"
+
+#include <android-base/logging.h>
+
+using ::aidl::android::hardware::light::FlashMode;
+using ::aidl::android::hardware::light::HwLight;
+using ::aidl::android::hardware::light::HwLightState;
+using ::aidl::android::hardware::light::LightType;
+using ::aidl::android::hardware::light::LightsColorLut;
+using ::aidl::android::hardware::light::LightsCurve;
+using ::aidl::android::hardware::light::LightsKeyframe;
+using ::aidl::android::hardware::light::LightsLed;
+using ::aidl::android::hardware::light::LightsPattern;
+using ::aidl::android::hardware::light::LightsRamp;
+using ::aidl::android::hardware::light::Lights;
+using ::aidl::android::hardware::light::LightsUpdate;
+using ::aidl::android::hardware::light::LightsUtils;
+
+#ifdef __ANDROID__
+static char const* const TMP_DIR_DEFAULT = "/data/local/tmp";
+#else
+static char const* const TMP_DIR_DEFAULT = "/tmp";
+#endif
+
+static int64_t const ONE_MS_IN_NS = 1000000LL;
+static int64_t const ONE_S_IN_NS = 1000000000LL;
+
+static thread_local bool sCountAllocations = false;
+static std::atomic<uint64_t> sAllocations{0};
+
+void* operator new(size_t size) {
+    if (sCountAllocations) {
+        sAllocations.fetch_add(1, std::memory_order_relaxed);
+    }
+    void* p = malloc(size ? size : 1);
+    if (p == nullptr) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void* p) noexcept {
+    free(p);
+}
+
+void operator delete[](void* p) noexcept {
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept {
+    free(p);
+}
+
+static int64_t now() {
+    struct timespec ts = {0, 0};
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ONE_S_IN_NS * ts.tv_sec + ts.tv_nsec;
+}
+
+/**
+ * Check that setLightState does not allocate heap memory once warmed up
+ * @param lights = service instance
+ * @param hwLights = lights to update
+ * @return 0 if success, error code otherwise
+ */
+static int checkAllocations(Lights* lights, const std::vector<HwLight>& hwLights) {
+    HwLightState state;
+    uint64_t total = 0;
+
+    state.flashOnMs = 500;
+    state.flashOffMs = 500;
+
+    for (const HwLight& light : hwLights) {
+        for (FlashMode mode : {FlashMode::NONE, FlashMode::HARDWARE, FlashMode::TIMED}) {
+            state.flashMode = mode;
+            state.color = 0xff000000;
+            lights->setLightState(light.id, state);
+
+            sAllocations.store(0);
+            sCountAllocations = true;
+            for (int i = 0; i < 100; i++) {
+                state.color = 0xff000000 | ((i + 1) * 0x010101);
+                lights->setLightState(light.id, state);
+            }
+            sCountAllocations = false;
+
+            uint64_t n = sAllocations.load();
+            if (n != 0) {
+                printf("%-14s %-9s %llu heap allocations in 100 calls\n",
+                       LightsUtils::getLightTypeName(light.type),
+                       LightsUtils::getFlashModeName(mode), (unsigned long long)n);
+            }
+            total += n;
+        }
+        state.color = 0;
+        state.flashMode = FlashMode::NONE;
+        lights->setLightState(light.id, state);
+    }
+
+    printf("%s\n", (total == 0) ? "none" : "FAILED: setLightState allocates");
+    return (total == 0) ? 0 : -1;
+}
+
+/**
+ * Check that a batch with an invalid update applies nothing
+ * @param lights = service instance
+ * @param hwLights = lights to update together, backlight excluded
+ * @param root = fake sysfs root
+ * @return 0 if success, error code otherwise
+ */
+static int checkBatch(Lights* lights, const std::vector<HwLight>& hwLights, const char* root) {
+    LightsUpdate updates[Lights::MAX_BATCH];
+    int nbUpdates = 0;
+    int keyboard = -1;
+
+    for (const HwLight& light : hwLights) {
+        if ((light.type != LightType::BACKLIGHT) && (nbUpdates < Lights::MAX_BATCH)) {
+            if (light.type == LightType::KEYBOARD) {
+                keyboard = nbUpdates;
+            }
+            updates[nbUpdates].id = light.id;
+            updates[nbUpdates].state = HwLightState();
+            updates[nbUpdates].state.color = 0xff808080;
+            nbUpdates++;
+        }
+    }
+    if (keyboard < 0) {
+        fprintf(stderr, "no keyboard light\n");
+        return -1;
+    }
+
+    bool applied = (lights->setLightStates(updates, nbUpdates) == 0);
+    updates[keyboard].state.color = 0xffffffff;
+    updates[nbUpdates].id = 1000;
+    updates[nbUpdates].state = HwLightState();
+    bool rejected = (lights->setLightStates(updates, nbUpdates + 1) != 0);
+    lights->flush();
+    long int brightness = readNode(root, FAKE_OTHER_LEDS[0], "brightness");
+
+    for (int u = 0; u < nbUpdates; u++) {
+        updates[u].state.color = 0;
+    }
+    lights->setLightStates(updates, nbUpdates);
+    lights->flush();
+
+    bool ok = applied && rejected && (brightness == 128);
+    printf("%d lights: valid batch %s, invalid batch %s%s\n", nbUpdates,
+           applied ? "applied" : "rejected",
+           (rejected && (brightness == 128)) ? "rejected" : "partially applied",
+           ok ? "" : " FAILED");
+    return ok ? 0 : -1;
+}
+
+/**
+ * Check the arbitration of two lights sharing the fake led: the high
+ * priority light masks the other one, which shows up once it is released
+ * @param lights = service instance
+ * @param high = high priority light (ATTENTION)
+ * @param low = low priority light (NOTIFICATIONS)
+ * @param root = fake sysfs root
+ * @return 0 if success, error code otherwise
+ */
+static int checkCompositor(Lights* lights, const HwLight& high, const HwLight& low,
+                           const char* root) {
+    HwLightState state;
+
+    /* three digit brightness only, the fake nodes are not truncated */
+    state.color = 0xffffffff;
+    lights->setLightState(high.id, state);
+    state.color = 0xff808080;
+    lights->setLightState(low.id, state);
+    lights->flush();
+    long int masked = readNode(root, FAKE_LED, "brightness");
+
+    state.color = 0;
+    lights->setLightState(high.id, state);
+    lights->flush();
+    long int released = readNode(root, FAKE_LED, "brightness");
+    lights->setLightState(low.id, state);
+
+    bool ok = (masked == 255) && (released > 0) && (released < 255);
+    printf("%s over %s: masked=%ld released=%ld%s\n", LightsUtils::getLightTypeName(high.type),
+           LightsUtils::getLightTypeName(low.type), masked, released, ok ? "" : " FAILED");
+    return ok ? 0 : -1;
+}
+
+/**
+ * Retime a light flashing many times faster than its period: retiming
+ * must not restart the flash (no extra edge)
+ * @param lights = service instance
+ * @param light = light to flash
+ * @param root = fake sysfs root
+ * @return 0 if success, error code otherwise
+ */
+static int checkFlashRetime(Lights* lights, const HwLight& light, const char* root) {
+    HwLightState state;
+    int durationMs = 300;
+    int retimes = 0;
+    int edges = 0;
+
+    int fd = watchNode(root, FAKE_LED, "brightness");
+    if (fd < 0) {
+        return -1;
+    }
+
+    state.flashMode = FlashMode::TIMED;
+    state.color = 0xffffffff;
+    state.flashOnMs = 50;
+    state.flashOffMs = 50;
+    lights->setLightState(light.id, state);
+    usleep(120000);
+    countWrites(fd, 0, nullptr);
+
+    /* one retime every 5ms, delays alternating 40ms and 60ms */
+    int64_t end = now() + durationMs * ONE_MS_IN_NS;
+    for (; now() < end; retimes++) {
+        state.color = (retimes & 1) ? 0xff808080 : 0xffffffff;
+        state.flashOnMs = (retimes & 1) ? 60 : 40;
+        state.flashOffMs = (retimes & 1) ? 40 : 60;
+        lights->setLightState(light.id, state);
+        edges += countWrites(fd, 5, nullptr);
+    }
+    close(fd);
+
+    state.flashMode = FlashMode::NONE;
+    state.color = 0;
+    lights->setLightState(light.id, state);
+
+    /* 40ms phases at worst, without restart */
+    int maxEdges = durationMs / 40 + 2;
+    bool ok = (edges <= maxEdges);
+    printf("%-14s %d retimes: edges=%d (max %d)%s\n", LightsUtils::getLightTypeName(light.type),
+           retimes, edges, maxEdges, ok ? "" : " FAILED");
+    return ok ? 0 : -1;
+}
+
+/**
+ * Check that a flash stopped by a failed edge write is started again by
+ * the next TIMED request, instead of being retimed while unscheduled
+ * @param lights = service instance
+ * @param light = light to flash
+ * @param root = fake sysfs root
+ * @return 0 if success, error code otherwise
+ */
+static int checkFlashWriteError(Lights* lights, const HwLight& light, const char* root) {
+    LightsLed* led = LightsUtils::findLed(strrchr(FAKE_LED, '/') + 1);
+    HwLightState state;
+
+    int fd = watchNode(root, FAKE_LED, "brightness");
+    if ((led == nullptr) || (fd < 0)) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        return -1;
+    }
+
+    state.flashMode = FlashMode::TIMED;
+    state.color = 0xffffffff;
+    state.flashOnMs = 20;
+    state.flashOffMs = 20;
+    lights->setLightState(light.id, state);
+    usleep(50000);
+
+    /* brightness unwritable for one edge at least */
+    led->detach();
+    usleep(30000);
+    led->attach();
+    countWrites(fd, 0, nullptr);
+
+    state.flashOnMs = 30;
+    state.flashOffMs = 30;
+    lights->setLightState(light.id, state);
+    int edges = countWrites(fd, 200, nullptr);
+    close(fd);
+
+    state.flashMode = FlashMode::NONE;
+    state.color = 0;
+    lights->setLightState(light.id, state);
+
+    bool ok = (edges > 0);
+    printf("%-14s write error: edges after the next request=%d%s\n",
+           LightsUtils::getLightTypeName(light.type), edges, ok ? "" : " FAILED");
+    return ok ? 0 : -1;
+}
+
+/**
+ * Check the writes of a brightness transition and its retargeting
+ * @param root = fake sysfs root
+ * @param rateHz = update rate
+ * @param durationMs = transition duration
+ * @return 0 if success, error code otherwise
+ */
+static int checkRamp(const char* root, int rateHz, int durationMs) {
+    const char* dir = FAKE_OTHER_LEDS[0];
+    LightsLed* led = LightsUtils::getLed(strrchr(dir, '/') + 1, false);
+    LightsRamp ramp(led, rateHz);
+
+    led->setTrigger("none");
+    ramp.rampTo(0, 0);
+
+    int fd = watchNode(root, dir, "brightness");
+    if (fd < 0) {
+        return -1;
+    }
+
+    /* full range transition: bounded number of writes, target reached */
+    ramp.rampTo(255, durationMs);
+    int writes = countWrites(fd, durationMs + 50, nullptr);
+    close(fd);
+    long int reached = readNode(root, dir, "brightness");
+    int bound = durationMs * rateHz / 1000 + 1;
+
+    /* retarget half way: the transition goes back from where it is */
+    ramp.rampTo(0, durationMs);
+    usleep(durationMs * 500);
+    long int half = readNode(root, dir, "brightness");
+    ramp.rampTo(255, durationMs);
+    long int retargeted = readNode(root, dir, "brightness");
+    usleep((durationMs + 50) * 1000);
+    long int final = readNode(root, dir, "brightness");
+    ramp.stop();
+
+    bool ok = (writes <= bound) && (reached == 255) && (retargeted == half) && (final == 255);
+    printf("0->255 in %dms at %dHz: writes=%d (max %d) reached=%ld\n"
+           "retarget at %ld: level after retarget=%ld, final=%ld%s\n",
+           durationMs, rateHz, writes, bound, reached, half, retargeted, final,
+           ok ? "" : " FAILED");
+    return ok ? 0 : -1;
+}
+
+/**
+ * Play a pattern with a single call and check its outcome: the final
+ * level when played from userspace, the compiled pattern when played by
+ * the kernel
+ * @param lights = service
+ * @param light = light to animate
+ * @param root = fake sysfs root
+ * @param kernelBlink = led lists the "pattern" trigger
+ * @return 0 if success, error code otherwise
+ */
+static int checkPattern(Lights* lights, const HwLight& light, const char* root, bool kernelBlink) {
+    char path[PATH_MAX];
+    char buf[128] = {0};
+    const char* dir = FAKE_OTHER_LEDS[2];
+    LightsKeyframe frames[LightsPattern::MAX_KEYFRAMES];
+    /* on 100ms, off then ramp up in 100ms, played twice */
+    const char* spec = "255:100,0:50,0:100:r";
+    int nbFrames = LightsPattern::parse(spec, frames, LightsPattern::MAX_KEYFRAMES);
+    int repeat = 2;
+    bool ok;
+
+    int fd = watchNode(root, dir, "brightness");
+    if (fd < 0) {
+        return -1;
+    }
+    int ret = lights->setLightPattern(light.id, 0xffffffff, frames, nbFrames, repeat);
+    int writes = countWrites(fd, 600, nullptr);
+    close(fd);
+
+    if (kernelBlink) {
+        snprintf(path, sizeof(path), "%s/%s", root, dir);
+        strncat(path, "/pattern", sizeof(path) - strlen(path) - 1);
+        fd = open(path, O_RDONLY | O_CLOEXEC);
+        if ((fd < 0) || (read(fd, buf, sizeof(buf) - 1) < 0)) {
+            fprintf(stderr, "cannot read %s: %s\n", path, strerror(errno));
+        }
+        if (fd >= 0) {
+            close(fd);
+        }
+        ok = (ret == 0) && (strcmp(buf, "255 100 255 0 0 50 0 0 0 100") == 0) &&
+             (readNode(root, dir, "repeat") == repeat);
+        printf("%-14s \"%s\" x%d: 1 call, kernel pattern \"%s\"%s\n",
+               LightsUtils::getLightTypeName(light.type), spec, repeat, buf, ok ? "" : " FAILED");
+    } else {
+        long int final = readNode(root, dir, "brightness");
+        ok = (ret == 0) && (final == 255);
+        printf("%-14s \"%s\" x%d: 1 call, %d writes, final level %ld%s\n",
+               LightsUtils::getLightTypeName(light.type), spec, repeat, writes, final,
+               ok ? "" : " FAILED");
+    }
+
+    HwLightState state;
+    state.color = 0;
+    state.flashMode = FlashMode::NONE;
+    lights->setLightState(light.id, state);
+
+    return ok ? 0 : -1;
+}
+
+/**
+ * Check the color to brightness tables: black and white reach both ends
+ * of the device range, the curve is monotonic
+ * @return number of failed checks
+ */
+static int checkColorLut() {
+    int failures = 0;
+    LightsColorLut lut;
+
+    printf("%-11s %8s %8s %8s %8s\n", "curve", "max", "black", "grey", "white");
+    for (LightsCurve curve : {LightsCurve::LINEAR, LightsCurve::GAMMA, LightsCurve::PERCEPTUAL}) {
+        for (long int max : {1L, 255L, 1023L, 4095L}) {
+            lut.build(curve, max);
+
+            bool ok = (lut.getBrightness(0xff000000) == 0) &&
+                      (lut.getBrightness(0xffffffff) == max);
+            for (int level = 1; level < LightsColorLut::LUMA_LEVELS; level++) {
+                int color = 0xff000000 | (level << 16) | (level << 8) | level;
+                int prev = 0xff000000 | ((level - 1) << 16) | ((level - 1) << 8) | (level - 1);
+                ok &= (lut.getBrightness(color) >= lut.getBrightness(prev));
+            }
+            failures += ok ? 0 : 1;
+
+            printf("%-11s %8ld %8ld %8ld %8ld%s\n", LightsColorLut::getCurveName(curve), max,
+                   lut.getBrightness(0), lut.getBrightness(0x808080),
+                   lut.getBrightness(0xffffff), ok ? "" : " FAILED");
+        }
+    }
+    return failures;
+}
+
+/**
+ * Check that a multicolor led gets its channels in one multi_intensity write
+ * @param lights = service
+ * @param light = light backed by the multicolor led
+ * @param root = fake sysfs root
+ * @return 0 if success, error code otherwise
+ */
+static int checkMulticolor(Lights* lights, const HwLight& light, const char* root) {
+    char path[PATH_MAX];
+    char buf[64] = {0};
+    HwLightState state;
+
+    state.color = 0xffff00ff;
+    state.flashMode = FlashMode::NONE;
+    lights->setLightState(light.id, state);
+    lights->flush();
+
+    snprintf(path, sizeof(path), "%s/%s", root, FAKE_OTHER_LEDS[1]);
+    strncat(path, "/multi_intensity", sizeof(path) - strlen(path) - 1);
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if ((fd < 0) || (read(fd, buf, sizeof(buf) - 1) < 0)) {
+        fprintf(stderr, "cannot read %s: %s\n", path, strerror(errno));
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+
+    bool ok = (strncmp(buf, "255 0 255", 9) == 0);
+    printf("%-14s color=0x%08x multi_intensity=\"%.9s\"%s\n",
+           LightsUtils::getLightTypeName(light.type), (uint32_t)state.color, buf,
+           ok ? "" : " FAILED");
+    return ok ? 0 : -1;
+}
+
+/**
+ * Send a uevent of the leds subsystem to the service
+ * @param fd = injector end of the uevent socket
+ * @param action = "add" or "remove"
+ * @param name = led name
+ */
+static void injectUevent(int fd, const char* action, const char* name) {
+    char buf[512];
+    int size = 0;
+
+    size += snprintf(buf + size, sizeof(buf) - size, "%s@/devices/platform/leds/leds/%s",
+                     action, name) + 1;
+    size += snprintf(buf + size, sizeof(buf) - size, "ACTION=%s", action) + 1;
+    size += snprintf(buf + size, sizeof(buf) - size, "DEVPATH=/devices/platform/leds/leds/%s",
+                     name) + 1;
+    size += snprintf(buf + size, sizeof(buf) - size, "SUBSYSTEM=leds") + 1;
+    if (send(fd, buf, size, 0) < 0) {
+        fprintf(stderr, "cannot inject uevent: %s\n", strerror(errno));
+    }
+}
+
+/**
+ * Unplug a led, update its light while absent, then plug it back with
+ * its brightness node showing up late: the request is applied once the
+ * device is probed again
+ * @param lights = service instance
+ * @param light = light of the led
+ * @param root = fake sysfs root
+ * @param fd = injector end of the uevent socket
+ * @return 0 if success, error code otherwise
+ */
+static int checkHotplug(Lights* lights, const HwLight& light, const char* root, int fd) {
+    char dir[PATH_MAX];
+    char gone[PATH_MAX];
+    char node[PATH_MAX];
+    char parked[PATH_MAX];
+    HwLightState state;
+    const char* name = strrchr(FAKE_OTHER_LEDS[2], '/') + 1;
+    LightsLed* led = LightsUtils::findLed(name);
+
+    snprintf(dir, sizeof(dir), "%s/%s", root, FAKE_OTHER_LEDS[2]);
+    snprintf(gone, sizeof(gone), "%s.gone", dir);
+    snprintf(node, sizeof(node), "%s/brightness", dir);
+    snprintf(parked, sizeof(parked), "%s/brightness.parked", root);
+
+    /* three digit brightness only, the fake nodes are not truncated */
+    state.color = 0xff808080;
+    lights->setLightState(light.id, state);
+
+    rename(dir, gone);
+    injectUevent(fd, "remove", name);
+    for (int i = 0; (i < 1000) && led->isPresent(); i++) {
+        usleep(1000);
+    }
+    bool removed = !led->isPresent();
+
+    state.color = 0xffffffff;
+    bool deferred = lights->setLightState(light.id, state).isOk();
+
+    /* driver bound again, brightness node created 25ms after the uevent */
+    snprintf(node, sizeof(node), "%s/brightness", gone);
+    rename(node, parked);
+    rename(gone, dir);
+    snprintf(node, sizeof(node), "%s/brightness", dir);
+    int64_t start = now();
+    injectUevent(fd, "add", name);
+    usleep(25000);
+    rename(parked, node);
+
+    long int brightness = -1;
+    while ((now() - start < ONE_S_IN_NS) && (brightness != 255)) {
+        usleep(1000);
+        brightness = led->isPresent() ? readNode(root, FAKE_OTHER_LEDS[2], "brightness") : -1;
+    }
+    int64_t elapsed = now() - start;
+
+    state.color = 0;
+    lights->setLightState(light.id, state);
+
+    bool ok = removed && deferred && (brightness == 255);
+    printf("%-14s removed=%s deferred request=%s restored brightness=%ld after %lldms%s\n",
+           LightsUtils::getLightTypeName(light.type), removed ? "yes" : "no",
+           deferred ? "ok" : "error", brightness, (long long)(elapsed / ONE_MS_IN_NS),
+           ok ? "" : " FAILED");
+    return ok ? 0 : -1;
+}
+
+int main(int argc, char** argv) {
+    const char* tmpDir = TMP_DIR_DEFAULT;
+    bool kernelBlink = false;
+    bool verbose = false;
+    char root[PATH_MAX];
+    int failures = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "d:kv")) != -1) {
+        switch (opt) {
+            case 'd':
+                tmpDir = optarg;
+                break;
+            case 'k':
+                kernelBlink = true;
+                break;
+            case 'v':
+                verbose = true;
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-d <tmp dir>] [-k] [-v]\n", argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+
+    if (!verbose) {
+        ::android::base::SetMinimumLogSeverity(::android::base::WARNING);
+    }
+
+    snprintf(root, sizeof(root), "%s/lights-check-XXXXXX", tmpDir);
+    if ((mkdtemp(root) == nullptr) || (createFakeSysfs(root, kernelBlink) != 0)) {
+        fprintf(stderr, "cannot create fake sysfs in %s\n", tmpDir);
+        return EXIT_FAILURE;
+    }
+    LightsUtils::setSysfsRoot(root);
+
+    std::shared_ptr<Lights> lights = ndk::SharedRefBase::make<Lights>();
+    lights->warmUp();
+
+    std::vector<HwLight> hwLights;
+    lights->getLights(&hwLights);
+
+    printf("heap allocations:\n");
+    failures += (checkAllocations(lights.get(), hwLights) != 0);
+
+    printf("\nbatched updates:\n");
+    failures += (checkBatch(lights.get(), hwLights, root) != 0);
+
+    printf("\nlights sharing one device:\n");
+    const HwLight* attention = nullptr;
+    const HwLight* notifications = nullptr;
+    for (const HwLight& light : hwLights) {
+        if (light.type == LightType::ATTENTION) {
+            attention = &light;
+        } else if (light.type == LightType::NOTIFICATIONS) {
+            notifications = &light;
+        }
+    }
+    if ((attention != nullptr) && (notifications != nullptr)) {
+        failures += (checkCompositor(lights.get(), *attention, *notifications, root) != 0);
+    }
+
+    printf("\nflash retiming and write error:\n");
+    if (kernelBlink) {
+        printf("offloaded to the kernel timer trigger\n");
+    } else if (notifications != nullptr) {
+        failures += (checkFlashRetime(lights.get(), *notifications, root) != 0);
+        failures += (checkFlashWriteError(lights.get(), *notifications, root) != 0);
+    }
+
+    printf("\nbrightness transition:\n");
+    failures += (checkRamp(root, 60, 500) != 0);
+
+    printf("\nkeyframe pattern:\n");
+    for (const HwLight& light : hwLights) {
+        if (light.type == LightType::WIFI) {
+            failures += (checkPattern(lights.get(), light, root, kernelBlink) != 0);
+        }
+    }
+
+    printf("\ncolor conversion:\n");
+    failures += checkColorLut();
+    for (const HwLight& light : hwLights) {
+        if (light.type == LightType::BATTERY) {
+            failures += (checkMulticolor(lights.get(), light, root) != 0);
+        }
+    }
+
+    printf("\nhotplug, local uevent injector:\n");
+    int sockets[2];
+    if (LightsUtils::isHotplugEnabled()) {
+        printf("kernel uevents listened, injector skipped\n");
+    } else if ((socketpair(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0, sockets) != 0) ||
+        (lights->startHotplug(sockets[0]) != 0)) {
+        fprintf(stderr, "cannot start the hotplug injector\n");
+        failures++;
+    } else {
+        for (const HwLight& light : hwLights) {
+            if (light.type == LightType::WIFI) {
+                failures += (checkHotplug(lights.get(), light, root, sockets[1]) != 0);
+            }
+        }
+    }
+
+    printf("\n%d check(s) failed\n", failures);
+
+    removeFakeSysfs(root);
+    return (failures == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
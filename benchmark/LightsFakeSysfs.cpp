@@ -0,0 +1,214 @@
+/*
+ * Copyright (C) 2024 STMicroelectronics
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <ftw.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "LightsFakeSysfs.h"
+
+static char const* const FAKE_MULTICOLOR_PREFIX = "class/leds/multicolor:";
+
+/**
+ * Create a fake sysfs node
+ * @param root = fake sysfs root
+ * @param dir = node directory, relative to root
+ * @param node = node name
+ * @param content = initial content
+ * @return 0 if success, error code otherwise
+ */
+static int makeNode(const char* root, const char* dir, const char* node, const char* content) {
+    char path[PATH_MAX];
+
+    snprintf(path, sizeof(path), "%s/%s/%s", root, dir, node);
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        fprintf(stderr, "cannot create %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    ssize_t wb = write(fd, content, strlen(content));
+    close(fd);
+    return (wb < 0) ? -1 : 0;
+}
+
+static int makeDirs(const char* root, const char* dir) {
+    char path[PATH_MAX];
+
+    snprintf(path, sizeof(path), "%s/%s", root, dir);
+    for (char* p = path + strlen(root) + 1; *p != '\0'; p++) {
+        if (*p == '/') {
+            *p = '\0';
+            mkdir(path, 0755);
+            *p = '/';
+        }
+    }
+    if ((mkdir(path, 0755) != 0) && (errno != EEXIST)) {
+        fprintf(stderr, "cannot create %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Create a fake led
+ * @param root = fake sysfs root
+ * @param led = led directory, relative to root
+ * @param kernelBlink = list the timer and pattern triggers
+ * @return 0 if success, error code otherwise
+ */
+static int createFakeLed(const char* root, const char* led, bool kernelBlink) {
+    int ret = 0;
+
+    ret |= makeDirs(root, led);
+    ret |= makeNode(root, led, "brightness", "0\n");
+    ret |= makeNode(root, led, "max_brightness", "255\n");
+    ret |= makeNode(root, led, "trigger",
+                    kernelBlink ? "[none] timer pattern heartbeat\n" : "[none] heartbeat\n");
+    if (kernelBlink) {
+        ret |= makeNode(root, led, "delay_on", "500\n");
+        ret |= makeNode(root, led, "delay_off", "500\n");
+        ret |= makeNode(root, led, "pattern", "\n");
+        /* nodes are overwritten in place: start empty to read back the last write */
+        ret |= makeNode(root, led, "repeat", "");
+    }
+    if (strncmp(led, FAKE_MULTICOLOR_PREFIX, strlen(FAKE_MULTICOLOR_PREFIX)) == 0) {
+        ret |= makeNode(root, led, "multi_index", "red green blue\n");
+        ret |= makeNode(root, led, "multi_intensity", "0 0 0\n");
+    }
+
+    return ret;
+}
+
+/**
+ * Create a fake sysfs tree with the board leds and backlight
+ * @param root = fake sysfs root
+ * @param kernelBlink = list the timer and pattern triggers
+ * @return 0 if success, error code otherwise
+ */
+int createFakeSysfs(const char* root, bool kernelBlink) {
+    int ret = 0;
+
+    ret |= createFakeLed(root, FAKE_LED, kernelBlink);
+    for (const char* led : FAKE_OTHER_LEDS) {
+        ret |= createFakeLed(root, led, kernelBlink);
+    }
+
+    ret |= makeDirs(root, FAKE_BACKLIGHT);
+    ret |= makeNode(root, FAKE_BACKLIGHT, "brightness", "0\n");
+    ret |= makeNode(root, FAKE_BACKLIGHT, "max_brightness", "255\n");
+
+    return ret;
+}
+
+static int removeNode(const char* path, const struct stat*, int, struct FTW*) {
+    return remove(path);
+}
+
+/**
+ * Remove a fake sysfs tree
+ * @param root = fake sysfs root
+ */
+void removeFakeSysfs(const char* root) {
+    nftw(root, removeNode, 16, FTW_DEPTH | FTW_PHYS);
+}
+
+/**
+ * Read a sysfs node of the fake tree as a number
+ * @param root = fake sysfs root
+ * @param dir = device directory, relative to root
+ * @param node = node name
+ * @return value, -1 on error
+ */
+long int readNode(const char* root, const char* dir, const char* node) {
+    char path[PATH_MAX];
+    char buf[32] = {0};
+
+    snprintf(path, sizeof(path), "%s/%s", root, dir);
+    strncat(path, "/", sizeof(path) - strlen(path) - 1);
+    strncat(path, node, sizeof(path) - strlen(path) - 1);
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+    ssize_t rb = read(fd, buf, sizeof(buf) - 1);
+    close(fd);
+    return (rb > 0) ? strtol(buf, nullptr, 10) : -1;
+}
+
+/**
+ * Watch the writes to a sysfs node of the fake tree
+ * @param root = fake sysfs root
+ * @param dir = device directory, relative to root
+ * @param node = node name
+ * @return watch descriptor to pass to countWrites() then close, -1 on error
+ */
+int watchNode(const char* root, const char* dir, const char* node) {
+    char path[PATH_MAX];
+
+    snprintf(path, sizeof(path), "%s/%s", root, dir);
+    strncat(path, "/", sizeof(path) - strlen(path) - 1);
+    strncat(path, node, sizeof(path) - strlen(path) - 1);
+    int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if ((fd < 0) || (inotify_add_watch(fd, path, IN_MODIFY) < 0)) {
+        fprintf(stderr, "cannot watch %s: %s\n", path, strerror(errno));
+        if (fd >= 0) {
+            close(fd);
+        }
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * Count the writes to a watched node. Identical unread events are merged
+ * by inotify, so they are read as they come.
+ * @param fd = watchNode() descriptor
+ * @param durationMs = how long to count, 0 to only consume the pending ones
+ * @param times = if not null, CLOCK_MONOTONIC time of each write, in ns
+ * @return number of writes
+ */
+int countWrites(int fd, int durationMs, std::vector<int64_t>* times) {
+    char event[sizeof(struct inotify_event) + NAME_MAX + 1]
+            __attribute__((aligned(__alignof__(struct inotify_event))));
+    struct timespec ts = {0, 0};
+    int writes = 0;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    int64_t end = 1000000000LL * ts.tv_sec + ts.tv_nsec + durationMs * 1000000LL;
+    for (;;) {
+        if (read(fd, event, sizeof(event)) > 0) {
+            clock_gettime(CLOCK_MONOTONIC, &ts);
+            if (times != nullptr) {
+                times->push_back(1000000000LL * ts.tv_sec + ts.tv_nsec);
+            }
+            writes++;
+            continue;
+        }
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        if (1000000000LL * ts.tv_sec + ts.tv_nsec >= end) {
+            return writes;
+        }
+        usleep(100);
+    }
+}
@@ -0,0 +1,40 @@
+/*
+ * Copyright (C) 2024 STMicroelectronics
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Fake sysfs tree of the board leds and backlight, shared by the
+ * benchmark and the soak test.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+static char const* const FAKE_LED = "class/leds/blue:heartbeat";
+/* other leds, found from their function name */
+static char const* const FAKE_OTHER_LEDS[] = {
+    "class/leds/white:kbd_backlight",
+    "class/leds/multicolor:charging",
+    "class/leds/blue:wlan",
+};
+static char const* const FAKE_BACKLIGHT = "class/backlight/panel-lvds-backlight";
+
+int createFakeSysfs(const char* root, bool kernelBlink);
+void removeFakeSysfs(const char* root);
+long int readNode(const char* root, const char* dir, const char* node);
+int watchNode(const char* root, const char* dir, const char* node);
+int countWrites(int fd, int durationMs, std::vector<int64_t>* times);
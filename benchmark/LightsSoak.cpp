@@ -0,0 +1,372 @@
+/*
+ * Copyright (C) 2024 STMicroelectronics
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Lights service soak test, run against a fake sysfs tree.
+ *
+ * usage: lights_soak [-d <tmp dir>] [-c <clients>] [-s <seconds>] [-i <seconds>] [-k] [-v]
+ *   -d: directory where the fake sysfs tree is created
+ *   -c: number of concurrent clients
+ *   -s: soak duration
+ *   -i: report interval
+ *   -k: fake leds list the kernel "timer" and "pattern" triggers
+ *   -v: keep the service logs
+ *
+ * Clients call setLightState with random lights, colors and flash modes,
+ * getLights and setLightStates. Each interval reports the throughput, the
+ * call latency, the process threads and the live heap allocations. The
+ * final dump gives the write lock wait of each device and the flash
+ * start/stop counts of each light.
+ *
+ * It fails if threads or heap allocations (C++ allocations) are left
+ * after the soak, compared to the end of a warm-up run.
+ */
+
+#include <atomic>
+#include <dirent.h>
+#include <limits.h>
+#include <new>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+
+#include "Lights.h"
+#include "LightsFakeSysfs.h"
+
+#include <android-base/logging.h>
+
+using ::aidl::android::hardware::light::FlashMode;
+using ::aidl::android::hardware::light::HwLight;
+using ::aidl::android::hardware::light::HwLightState;
+using ::aidl::android::hardware::light::LightType;
+using ::aidl::android::hardware::light::Lights;
+using ::aidl::android::hardware::light::LightsHistogram;
+using ::aidl::android::hardware::light::LightsUpdate;
+using ::aidl::android::hardware::light::LightsUtils;
+
+#ifdef __ANDROID__
+static char const* const TMP_DIR_DEFAULT = "/data/local/tmp";
+#else
+static char const* const TMP_DIR_DEFAULT = "/tmp";
+#endif
+
+static int64_t const ONE_MS_IN_NS = 1000000LL;
+static int64_t const ONE_S_IN_NS = 1000000000LL;
+
+static std::atomic<int64_t> sLiveAllocations{0};
+
+void* operator new(size_t size) {
+    void* p = malloc(size ? size : 1);
+    if (p == nullptr) {
+        throw std::bad_alloc();
+    }
+    sLiveAllocations.fetch_add(1, std::memory_order_relaxed);
+    return p;
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+static void release(void* p) {
+    if (p != nullptr) {
+        sLiveAllocations.fetch_sub(1, std::memory_order_relaxed);
+    }
+    free(p);
+}
+
+void operator delete(void* p) noexcept {
+    release(p);
+}
+
+void operator delete[](void* p) noexcept {
+    release(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    release(p);
+}
+
+void operator delete[](void* p, size_t) noexcept {
+    release(p);
+}
+
+static int64_t now() {
+    struct timespec ts = {0, 0};
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ONE_S_IN_NS * ts.tv_sec + ts.tv_nsec;
+}
+
+/**
+ * Count the threads of the process
+ * @return number of threads, -1 on error
+ */
+static int countThreads() {
+    int count = 0;
+
+    DIR* d = opendir("/proc/self/task");
+    if (d == nullptr) {
+        return -1;
+    }
+    for (struct dirent* entry = readdir(d); entry != nullptr; entry = readdir(d)) {
+        if (entry->d_name[0] != '.') {
+            count++;
+        }
+    }
+    closedir(d);
+    return count;
+}
+
+/**
+ * Get the resident memory of the process
+ * @return resident size in kB, -1 on error
+ */
+static long int getRssKb() {
+    long int size;
+    long int resident = -1;
+
+    FILE* file = fopen("/proc/self/statm", "re");
+    if (file == nullptr) {
+        return -1;
+    }
+    if (fscanf(file, "%ld %ld", &size, &resident) != 2) {
+        resident = -1;
+    }
+    fclose(file);
+    return (resident < 0) ? -1 : resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+/* counters of the current run, read by the reporting thread */
+struct SoakStats {
+    std::atomic<bool> stop{false};
+    std::atomic<uint64_t> calls{0};
+    std::atomic<uint64_t> errors{0};
+    LightsHistogram setLatency;
+    LightsHistogram getLatency;
+    LightsHistogram batchLatency;
+};
+
+/**
+ * Client: random updates until stopped
+ * @param lights = service
+ * @param hwLights = lights of the service
+ * @param seed = random seed of the client
+ * @param stats = shared counters
+ */
+static void runClient(Lights* lights, const std::vector<HwLight>* hwLights, unsigned int seed,
+                      SoakStats* stats) {
+    HwLightState state;
+    LightsUpdate updates[3];
+    int nbLights = hwLights->size();
+
+    while (!stats->stop.load(std::memory_order_relaxed)) {
+        int r = rand_r(&seed);
+        int64_t t0 = now();
+        bool error = false;
+
+        if (r % 32 == 0) {
+            std::vector<HwLight> list;
+            error = !lights->getLights(&list).isOk() || (list.size() != hwLights->size());
+            stats->getLatency.record(now() - t0);
+        } else if (r % 32 == 1) {
+            for (int i = 0; i < 3; i++) {
+                updates[i].id = (*hwLights)[rand_r(&seed) % nbLights].id;
+                updates[i].state = HwLightState();
+                updates[i].state.color = 0xff000000 | (rand_r(&seed) & 0xffffff);
+            }
+            error = (lights->setLightStates(updates, 3) != 0);
+            stats->batchLatency.record(now() - t0);
+        } else {
+            /* NONE 50%, TIMED 30%, HARDWARE 20% */
+            int mode = rand_r(&seed) % 10;
+            state.flashMode = (mode < 5) ? FlashMode::NONE :
+                              (mode < 8) ? FlashMode::TIMED : FlashMode::HARDWARE;
+            state.color = (rand_r(&seed) % 4 == 0) ? 0 : 0xff000000 | (rand_r(&seed) & 0xffffff);
+            state.flashOnMs = 20 + rand_r(&seed) % 1000;
+            state.flashOffMs = 20 + rand_r(&seed) % 1000;
+            error = !lights->setLightState((*hwLights)[rand_r(&seed) % nbLights].id, state).isOk();
+            stats->setLatency.record(now() - t0);
+        }
+
+        stats->calls.fetch_add(1, std::memory_order_relaxed);
+        if (error) {
+            stats->errors.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+}
+
+/**
+ * Run the clients for a while, then switch every light off
+ * @param lights = service
+ * @param hwLights = lights of the service
+ * @param clients = number of clients
+ * @param seconds = run duration
+ * @param interval = report interval in seconds, 0 for no report
+ * @param stats = counters
+ */
+static void runSoak(Lights* lights, const std::vector<HwLight>& hwLights, int clients,
+                    int seconds, int interval, SoakStats* stats) {
+    std::vector<std::thread> threads;
+    int64_t start = now();
+    int64_t end = start + seconds * ONE_S_IN_NS;
+    uint64_t lastCalls = 0;
+    int64_t last = start;
+
+    stats->stop = false;
+    for (int c = 0; c < clients; c++) {
+        threads.emplace_back(runClient, lights, &hwLights, (unsigned int)(start + c), stats);
+    }
+
+    while (now() < end) {
+        int64_t next = (interval > 0) ? last + interval * ONE_S_IN_NS : end;
+        next = (next < end) ? next : end;
+        int64_t wait = next - now();
+        if (wait > 0) {
+            usleep(wait / 1000);
+        }
+        if (interval <= 0) {
+            continue;
+        }
+
+        int64_t t = now();
+        uint64_t calls = stats->calls.load(std::memory_order_relaxed);
+        printf("%7.0fs %10.0f %7lld %7lld %7lld %8lld %6llu %7d %9lld %8ld\n",
+               (double)(t - start) / ONE_S_IN_NS,
+               (double)(calls - lastCalls) * ONE_S_IN_NS / (t - last),
+               (long long)stats->setLatency.getPercentileUs(50),
+               (long long)stats->setLatency.getPercentileUs(99),
+               (long long)stats->setLatency.getPercentileUs(99.9),
+               (long long)(stats->setLatency.getMaxNs() / 1000),
+               (unsigned long long)stats->errors.load(std::memory_order_relaxed),
+               countThreads(), (long long)sLiveAllocations.load(std::memory_order_relaxed),
+               getRssKb());
+        fflush(stdout);
+        stats->setLatency.reset();
+        lastCalls = calls;
+        last = t;
+    }
+
+    stats->stop = true;
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    HwLightState off;
+    for (const HwLight& light : hwLights) {
+        lights->setLightState(light.id, off);
+    }
+    lights->flush();
+}
+
+int main(int argc, char** argv) {
+    const char* tmpDir = TMP_DIR_DEFAULT;
+    int clients = 8;
+    int seconds = 60;
+    int interval = 10;
+    bool kernelBlink = false;
+    bool verbose = false;
+    char root[PATH_MAX];
+    int opt;
+
+    while ((opt = getopt(argc, argv, "d:c:s:i:kv")) != -1) {
+        switch (opt) {
+            case 'd':
+                tmpDir = optarg;
+                break;
+            case 'c':
+                clients = atoi(optarg);
+                break;
+            case 's':
+                seconds = atoi(optarg);
+                break;
+            case 'i':
+                interval = atoi(optarg);
+                break;
+            case 'k':
+                kernelBlink = true;
+                break;
+            case 'v':
+                verbose = true;
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-d <tmp dir>] [-c <clients>] [-s <seconds>] [-i <seconds>] [-k] [-v]\n", argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+
+    if (!verbose) {
+        ::android::base::SetMinimumLogSeverity(::android::base::WARNING);
+    }
+
+    snprintf(root, sizeof(root), "%s/lights-soak-XXXXXX", tmpDir);
+    if ((mkdtemp(root) == nullptr) || (createFakeSysfs(root, kernelBlink) != 0)) {
+        fprintf(stderr, "cannot create fake sysfs in %s\n", tmpDir);
+        return EXIT_FAILURE;
+    }
+    LightsUtils::setSysfsRoot(root);
+
+    std::shared_ptr<Lights> lights = ndk::SharedRefBase::make<Lights>();
+    lights->warmUp();
+
+    std::vector<HwLight> hwLights;
+    lights->getLights(&hwLights);
+    if (hwLights.empty()) {
+        fprintf(stderr, "no light in the fake sysfs tree\n");
+        return EXIT_FAILURE;
+    }
+
+    /* lazy allocations and threads are done by the end of the warm-up */
+    SoakStats warmUp;
+    runSoak(lights.get(), hwLights, clients, 2, 0, &warmUp);
+    usleep(100000);
+    int threads = countThreads();
+    int64_t allocations = sLiveAllocations.load();
+
+    printf("%d clients, %d lights, %ds, warm-up: %llu calls, %d threads, %lld live allocations\n\n",
+           clients, (int)hwLights.size(), seconds,
+           (unsigned long long)warmUp.calls.load(), threads, (long long)allocations);
+    printf("%8s %10s %7s %7s %7s %8s %6s %7s %9s %8s\n", "time", "calls/s", "p50<us", "p99<us",
+           "p999<us", "max(us)", "errors", "threads", "live allocs", "rss(kB)");
+
+    SoakStats stats;
+    int64_t start = now();
+    runSoak(lights.get(), hwLights, clients, seconds, interval, &stats);
+    int64_t elapsed = now() - start;
+    usleep(100000);
+
+    int leakedThreads = countThreads() - threads;
+    int64_t leakedAllocations = sLiveAllocations.load() - allocations;
+    uint64_t calls = stats.calls.load();
+
+    printf("\ntotal: %llu calls, %.0f calls/s, %llu errors\n", (unsigned long long)calls,
+           (elapsed > 0) ? (double)calls * ONE_S_IN_NS / elapsed : 0.0,
+           (unsigned long long)stats.errors.load());
+    stats.getLatency.dump(STDOUT_FILENO, "getLights latency");
+    stats.batchLatency.dump(STDOUT_FILENO, "setLightStates latency");
+    printf("leaked threads=%d leaked allocations=%lld\n\n", leakedThreads,
+           (long long)leakedAllocations);
+    fflush(stdout);
+
+    lights->dump(STDOUT_FILENO, nullptr, 0);
+
+    removeFakeSysfs(root);
+    return ((leakedThreads == 0) && (leakedAllocations == 0)) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
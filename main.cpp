@@ -15,21 +15,48 @@
  */
 
 #include "Lights.h"
+#include "LightsScheduler.h"
 
 #include <android-base/logging.h>
+#include <android-base/properties.h>
 #include <android/binder_manager.h>
 #include <android/binder_process.h>
 
 using ::aidl::android::hardware::light::Lights;
+using ::aidl::android::hardware::light::LightsScheduler;
 
 int main() {
-    ABinderProcess_setThreadPoolMaxThreadCount(0);
+    int64_t start = LightsScheduler::getTimestampMonotonic();
+
+    // Extra binder threads, so that a slow device does not block updates of the others
+    uint32_t threads = ::android::base::GetUintProperty<uint32_t>("ro.vendor.lights.binder_threads",
+                                                                  0, 16);
+    ABinderProcess_setThreadPoolMaxThreadCount(threads);
+    if (threads > 0) {
+        ABinderProcess_startThreadPool();
+    }
+
     std::shared_ptr<Lights> lights = ndk::SharedRefBase::make<Lights>();
 
     const std::string instance = std::string() + Lights::descriptor + "/default";
     binder_status_t status = AServiceManager_addService(lights->asBinder().get(), instance.c_str());
     CHECK(status == STATUS_OK);
 
+    // Boot critical part: from process start to service registered
+    int64_t elapsed = LightsScheduler::getTimestampMonotonic() - start;
+    int64_t budget = ::android::base::GetIntProperty("ro.vendor.lights.startup_budget_ms", 20, 0,
+                                                     1000) * 1000000LL;
+    lights->setRegisterTime(elapsed);
+    if ((budget > 0) && (elapsed > budget)) {
+        LOG(WARNING) << "Lights service registered in " << elapsed / 1000 << "us, over the "
+                     << budget / 1000 << "us budget";
+    } else {
+        LOG(INFO) << "Lights service registered in " << elapsed / 1000 << "us";
+    }
+
+    // Threads not needed to answer the first calls are started once registered
+    lights->warmUp();
+
     ABinderProcess_joinThreadPool();
     return EXIT_FAILURE;  // should not reached
 }
@@ -0,0 +1,92 @@
+#!/usr/bin/env python3
+#
+# Copyright (C) 2024 STMicroelectronics
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+"""Decode the lights service event trace.
+
+Usage:
+  adb shell dumpsys android.hardware.light.ILights/default --trace | lights_trace.py
+  lights_trace.py dump.txt
+
+Events of every thread are merged in time order.
+"""
+
+import sys
+
+# keep in sync with LightsTraceEvent (LightsTrace.h)
+EVENTS = {
+    1: ("setLightState", "light", lambda a: "color=0x%08x" % a),
+    2: ("setLightState done", "light", lambda a: "status=%d" % (a - (1 << 32) if a >> 31 else a)),
+    3: ("flash start", "light", lambda a: "on=%dms" % a),
+    4: ("flash stop", "light", lambda a: ""),
+    5: ("flash edge", "light", lambda a: "color=0x%08x" % a),
+    6: ("led color", "led", lambda a: "brightness=%d" % a),
+    7: ("backlight", "led", lambda a: "brightness=%d" % a),
+    8: ("led kernel flash", "led", lambda a: "backend=%s" % BACKENDS.get(a, a)),
+    9: ("led ramp", "led", lambda a: "target=%d" % a),
+    10: ("led write error", "led", lambda a: "errno=%d" % a),
+    11: ("pattern start", "light", lambda a: "backend=%s" % BACKENDS.get(a, a)),
+    12: ("pattern stop", "light", lambda a: ""),
+    13: ("setLightStates", "updates", lambda a: ""),
+    14: ("setLightStates done", "updates", lambda a: "status=%d" % (a - (1 << 32) if a >> 31 else a)),
+    15: ("flash retime", "light", lambda a: "on=%dms" % a),
+}
+
+# keep in sync with LightsBackend (LightsUtils.h)
+BACKENDS = {
+    0: "none", 1: "steady", 2: "kernel-heartbeat", 3: "kernel-timer",
+    4: "kernel-pattern", 5: "userspace", 6: "ramp",
+}
+
+
+def parse(lines):
+    events = []
+    in_trace = False
+    for line in lines:
+        if line.startswith("Trace: "):
+            in_trace = True
+            sys.stderr.write(line)
+            continue
+        if not in_trace:
+            continue
+        fields = line.split()
+        if len(fields) != 5:
+            continue
+        try:
+            tid, time, event, index, arg = (int(f) for f in fields)
+        except ValueError:
+            continue
+        events.append((time, tid, event, index, arg))
+    events.sort()
+    return events
+
+
+def main():
+    source = open(sys.argv[1]) if len(sys.argv) > 1 else sys.stdin
+    events = parse(source)
+    if not events:
+        sys.exit("no trace found, was the dump taken with --trace ?")
+
+    start = events[0][0]
+    previous = start
+    for time, tid, event, index, arg in events:
+        name, kind, decode = EVENTS.get(event, ("event %d" % event, "id", lambda a: "arg=%d" % a))
+        print("%12.3fms %+9.3fms tid=%-6d %-20s %s=%-2d %s" % (
+            (time - start) / 1e6, (time - previous) / 1e6, tid, name, kind, index, decode(arg)))
+        previous = time
+
+
+if __name__ == "__main__":
+    main()